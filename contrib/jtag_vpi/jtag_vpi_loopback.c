@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * This is a stand-in for a simulator running the jtag_vpi server, to be
+ * used for measuring the overhead of the OpenOCD jtag_vpi interface driver
+ * without a real simulation behind it.
+ *
+ * Every scan is looped back, i.e. the captured TDO bits are the TDI bits.
+ * Optionally each scan response can be delayed to model the time a
+ * simulator needs to advance. When the connection is closed, the number
+ * of commands and scan round trips per second are printed.
+ *
+ * To compile run:
+ * gcc -Wall -std=c99 -D_POSIX_C_SOURCE=200809L -o jtag_vpi_loopback jtag_vpi_loopback.c
+ *
+ * Usage example:
+ * ./jtag_vpi_loopback [port [delay_us]]
+ *
+ * On host run:
+ * openocd -c "adapter driver jtag_vpi; jtag_vpi set_port 5555; jtag_vpi pipeline 32" ...
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define XFERT_MAX_SIZE		512
+
+#define CMD_RESET		0
+#define CMD_TMS_SEQ		1
+#define CMD_SCAN_CHAIN		2
+#define CMD_SCAN_CHAIN_FLIP_TMS	3
+#define CMD_STOP_SIMU		4
+
+/* Same layout as in src/jtag/drivers/jtag_vpi.c, integers are little endian */
+struct vpi_cmd {
+	unsigned char cmd_buf[4];
+	unsigned char buffer_out[XFERT_MAX_SIZE];
+	unsigned char buffer_in[XFERT_MAX_SIZE];
+	unsigned char length_buf[4];
+	unsigned char nb_bits_buf[4];
+};
+
+static uint32_t le_to_u32(const unsigned char *buf)
+{
+	return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+	size_t done = 0;
+	while (done < len) {
+		ssize_t ret = read(fd, (char *)buf + done, len - done);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		done += ret;
+	}
+	return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	size_t done = 0;
+	while (done < len) {
+		ssize_t ret = write(fd, (const char *)buf + done, len - done);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		done += ret;
+	}
+	return 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void serve(int fd, unsigned int delay_us)
+{
+	struct vpi_cmd vpi;
+	unsigned long commands = 0, scans = 0, bits = 0;
+	double start = now();
+
+	while (read_all(fd, &vpi, sizeof(vpi)) == 0) {
+		uint32_t cmd = le_to_u32(vpi.cmd_buf);
+		commands++;
+
+		if (cmd == CMD_STOP_SIMU)
+			break;
+
+		if (cmd == CMD_SCAN_CHAIN || cmd == CMD_SCAN_CHAIN_FLIP_TMS) {
+			uint32_t length = le_to_u32(vpi.length_buf);
+			if (length > XFERT_MAX_SIZE)
+				length = XFERT_MAX_SIZE;
+			memcpy(vpi.buffer_in, vpi.buffer_out, length);
+			if (delay_us) {
+				struct timespec delay = {
+					.tv_sec = delay_us / 1000000,
+					.tv_nsec = (delay_us % 1000000) * 1000L,
+				};
+				nanosleep(&delay, NULL);
+			}
+			if (write_all(fd, &vpi, sizeof(vpi)) < 0)
+				break;
+			scans++;
+			bits += le_to_u32(vpi.nb_bits_buf);
+		}
+	}
+
+	double elapsed = now() - start;
+	fprintf(stderr, "%lu commands, %lu scans (%lu bits) in %.3f s\n",
+		commands, scans, bits, elapsed);
+	if (elapsed > 0)
+		fprintf(stderr, "%.0f commands/s, %.0f scan round trips/s\n",
+			commands / elapsed, scans / elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+	int port = argc > 1 ? atoi(argv[1]) : 5555;
+	unsigned int delay_us = argc > 2 ? atoi(argv[2]) : 0;
+
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd < 0) {
+		perror("socket");
+		return 1;
+	}
+
+	int one = 1;
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+			listen(listen_fd, 1) < 0) {
+		perror("bind/listen");
+		return 1;
+	}
+
+	fprintf(stderr, "jtag_vpi loopback listening on port %d\n", port);
+
+	int fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0) {
+		perror("accept");
+		return 1;
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	serve(fd, delay_us);
+
+	close(fd);
+	close(listen_fd);
+	return 0;
+}
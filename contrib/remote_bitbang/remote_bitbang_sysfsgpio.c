@@ -23,6 +23,8 @@
  * openocd -c "adapter driver remote_bitbang; remote_bitbang host raspberrypi; remote_bitbang port 7777" \
  *  -f target/stm32f1x.cfg
  *
+ * Add "remote_bitbang use_vectors on" to send whole scans as single messages.
+ *
  * Or if you want to test UNIX sockets, run both on Raspberry Pi:
  * socat UNIX-LISTEN:/tmp/remotebitbang-socket,fork EXEC:"sudo ./remote_bitbang_sysfsgpio tck 11 tms 25 tdo 9 tdi 10"
  * openocd -c "adapter driver remote_bitbang; remote_bitbang host /tmp/remotebitbang-socket" -f target/stm32f1x.cfg
@@ -390,6 +392,94 @@ static void cleanup_all_fds(void)
 	cleanup_fd(srst_fd, srst_gpio);
 }
 
+/* Vector protocol extension, see doc/manual/jtag/drivers/remote_bitbang.txt */
+#define VECTOR_VERSION		'1'
+#define VECTOR_MAX_BITS		(4096 * 8)
+#define VECTOR_CAPTURE		0x01
+#define VECTOR_EXIT		0x02
+
+static unsigned char vector_tdi[VECTOR_MAX_BITS / 8];
+static unsigned char vector_tdo[VECTOR_MAX_BITS / 8];
+
+/* Read a 32-bit little endian bit count, returns -1 on EOF. */
+static long read_vector_count(void)
+{
+	unsigned long count = 0;
+	for (int i = 0; i < 4; i++) {
+		int c = getchar();
+		if (c == EOF)
+			return -1;
+		count |= (unsigned long)c << (8 * i);
+	}
+	return count;
+}
+
+static int read_vector_bits(unsigned char *bits, unsigned long num_bits)
+{
+	size_t bytes = (num_bits + 7) / 8;
+	return fread(bits, 1, bytes, stdin) == bytes ? 0 : -1;
+}
+
+static int process_vector_tms(int zeros)
+{
+	long num_bits = read_vector_count();
+	if (num_bits < 0)
+		return -1;
+
+	int tms = 0;
+	unsigned long done = 0;
+	do {
+		unsigned long chunk = num_bits - done;
+		if (chunk > VECTOR_MAX_BITS)
+			chunk = VECTOR_MAX_BITS;
+		if (zeros)
+			memset(vector_tdi, 0, (chunk + 7) / 8);
+		else if (read_vector_bits(vector_tdi, chunk) < 0)
+			return -1;
+
+		for (unsigned long i = 0; i < chunk; i++) {
+			tms = (vector_tdi[i / 8] >> (i % 8)) & 1;
+			sysfsgpio_write(0, tms, 0);
+			sysfsgpio_write(1, tms, 0);
+		}
+		done += chunk;
+	} while (done < (unsigned long)num_bits);
+	sysfsgpio_write(0, tms, 0);
+
+	return 0;
+}
+
+static int process_vector_scan(void)
+{
+	int flags = getchar();
+	if (flags == EOF)
+		return -1;
+	long num_bits = read_vector_count();
+	if (num_bits < 0)
+		return -1;
+	if (num_bits > VECTOR_MAX_BITS) {
+		LOG_ERROR("Scan vector of %ld bits is too long", num_bits);
+		return -1;
+	}
+	if (read_vector_bits(vector_tdi, num_bits) < 0)
+		return -1;
+
+	memset(vector_tdo, 0, (num_bits + 7) / 8);
+	for (long i = 0; i < num_bits; i++) {
+		int tms = (flags & VECTOR_EXIT) && i == num_bits - 1;
+		int tdi = (vector_tdi[i / 8] >> (i % 8)) & 1;
+		sysfsgpio_write(0, tms, tdi);
+		if ((flags & VECTOR_CAPTURE) && sysfsgpio_read() == '1')
+			vector_tdo[i / 8] |= 1 << (i % 8);
+		sysfsgpio_write(1, tms, tdi);
+	}
+
+	if (flags & VECTOR_CAPTURE)
+		fwrite(vector_tdo, 1, (num_bits + 7) / 8, stdout);
+
+	return 0;
+}
+
 static void process_remote_protocol(void)
 {
 	int c;
@@ -417,6 +507,14 @@ static void process_remote_protocol(void)
 		else if (c >= 'd' && c <= 'g') { /* SWD write */
 			char d = c - 'd';
 			sysfsgpio_swd_write((d & 2), (d & 1));
+		} else if (c == 'V') /* Vector protocol version */
+			putchar(VECTOR_VERSION);
+		else if (c == 'T' || c == 'W') { /* TMS sequence, idle cycles */
+			if (process_vector_tms(c == 'W') < 0)
+				break;
+		} else if (c == 'S') { /* Scan vector */
+			if (process_vector_scan() < 0)
+				break;
 		}
 		else
 			LOG_ERROR("Unknown command '%c' received", c);
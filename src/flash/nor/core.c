@@ -16,6 +16,7 @@
 #include <flash/nor/core.h>
 #include <flash/nor/imp.h>
 #include <target/image.h>
+#include <helper/time_support.h>
 
 /**
  * @file
@@ -727,79 +728,85 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 }
 
 
-int flash_write_unlock_verify(struct target *target, struct image *image,
-	uint32_t *written, bool erase, bool unlock, bool write, bool verify)
-{
-	int retval = ERROR_OK;
-
+/* A contiguous block of flash written by a single driver call */
+struct flash_write_run {
+	struct flash_bank *bank;
+	target_addr_t address;
+	uint32_t size;
+	const uint8_t *buffer;
+	/* memory allocated for the buffer, to be released with free() */
+	uint8_t *alloc;
+};
+
+/* State of the walk through the sorted sections of an image */
+struct flash_write_iter {
+	struct target *target;
+	struct image *image;
+	/* sections in ascending order of addresses */
+	struct imagesection **sections;
+	/* padding after each section in the sorted list */
+	int *padding;
 	unsigned int section;
 	uint32_t section_offset;
-	struct flash_bank *c;
+};
 
-	section = 0;
-	section_offset = 0;
-
-	/* allocate padding array */
-	int *padding = calloc(image->num_sections, sizeof(*padding));
-
-	/* This fn requires all sections to be in ascending order of addresses,
-	 * whereas an image can have sections out of order. */
-	struct imagesection **sections = malloc(sizeof(struct imagesection *) *
-			image->num_sections);
-
-	if (!padding || !sections) {
-		LOG_ERROR("Out of memory");
-		free(padding);
-		free(sections);
-		return ERROR_FAIL;
-	}
-
-	if (written)
-		*written = 0;
-
-	if (erase) {
-		/* assume all sectors need erasing - stops any problems
-		 * when flash_write is called multiple times */
-
-		flash_set_dirty();
-	}
+static int flash_write_section_num(struct flash_write_iter *it)
+{
+	/* KLUDGE!
+	 *
+	 * #¤%#"%¤% we have to figure out the section # from the sorted
+	 * list of pointers to sections to invoke image_read_section()...
+	 */
+	intptr_t diff = (intptr_t)it->sections[it->section] - (intptr_t)it->image->sections;
+	return diff / sizeof(struct imagesection);
+}
 
-	for (unsigned int i = 0; i < image->num_sections; i++)
-		sections[i] = &image->sections[i];
+/**
+ * Collect the next run of consecutive image sections falling into the same
+ * flash bank, padded as required by the bank, and read it into a buffer.
+ * On return run->buffer is NULL once the end of the image is reached.
+ */
+static int flash_write_next_run(struct flash_write_iter *it,
+		bool erase, bool unlock, struct flash_write_run *run)
+{
+	struct image *image = it->image;
+	struct imagesection **sections = it->sections;
+	int *padding = it->padding;
+	struct flash_bank *c;
+	int retval;
 
-	qsort(sections, image->num_sections, sizeof(struct imagesection *),
-		compare_section);
+	run->buffer = NULL;
 
 	/* loop until we reach end of the image */
-	while (section < image->num_sections) {
+	while (it->section < image->num_sections) {
 		uint32_t buffer_idx;
 		uint8_t *buffer;
 		unsigned int section_last;
-		target_addr_t run_address = sections[section]->base_address + section_offset;
-		uint32_t run_size = sections[section]->size - section_offset;
+		target_addr_t run_address = sections[it->section]->base_address + it->section_offset;
+		uint32_t run_size = sections[it->section]->size - it->section_offset;
 		int pad_bytes = 0;
 
-		if (sections[section]->size ==  0) {
-			LOG_WARNING("empty section %d", section);
-			section++;
-			section_offset = 0;
+		if (sections[it->section]->size ==  0) {
+			LOG_WARNING("empty section %d", it->section);
+			it->section++;
+			it->section_offset = 0;
 			continue;
 		}
 
 		/* find the corresponding flash bank */
-		retval = get_flash_bank_by_addr(target, run_address, false, &c);
+		retval = get_flash_bank_by_addr(it->target, run_address, false, &c);
 		if (retval != ERROR_OK)
-			goto done;
+			return retval;
 		if (!c) {
 			LOG_WARNING("no flash bank found for address " TARGET_ADDR_FMT, run_address);
-			section++;	/* and skip it */
-			section_offset = 0;
+			it->section++;	/* and skip it */
+			it->section_offset = 0;
 			continue;
 		}
 
 		/* collect consecutive sections which fall into the same bank */
-		section_last = section;
-		padding[section] = 0;
+		section_last = it->section;
+		padding[it->section] = 0;
 		while ((run_address + run_size - 1 < c->base + c->size - 1) &&
 				(section_last + 1 < image->num_sections)) {
 			/* sections are sorted */
@@ -819,8 +826,7 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 					" overlaps section ending at " TARGET_ADDR_FMT,
 					next_section_base, run_next_addr);
 				LOG_ERROR("Flash write aborted.");
-				retval = ERROR_FAIL;
-				goto done;
+				return ERROR_FAIL;
 			}
 
 			pad_bytes = next_section_base - run_next_addr;
@@ -900,12 +906,46 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 			run_size += delta;
 		}
 
+		/* a run made of a single section without padding is taken from
+		 * the image content in memory. Some drivers modify the buffer they
+		 * are given, so memory owned by the image (a file mapping or the
+		 * sections of IHEX, S-record and builder images) is still copied,
+		 * only a buffer read for this run is used in place */
+		if (!padding_at_start && !padding[it->section]
+				&& run_size == sections[it->section]->size - it->section_offset) {
+			const uint8_t *data;
+			size_t size_read;
+
+			retval = image_section_data(image, flash_write_section_num(it),
+					it->section_offset, run_size, &data, &buffer, &size_read);
+			if (retval != ERROR_OK)
+				return retval;
+
+			if (!buffer) {
+				buffer = malloc(run_size);
+				if (!buffer) {
+					LOG_ERROR("Out of memory for flash bank buffer");
+					return ERROR_FAIL;
+				}
+				memcpy(buffer, data, run_size);
+			}
+
+			it->section++;
+			it->section_offset = 0;
+
+			run->bank = c;
+			run->address = run_address;
+			run->size = run_size;
+			run->buffer = buffer;
+			run->alloc = buffer;
+			break;
+		}
+
 		/* allocate buffer */
 		buffer = malloc(run_size);
 		if (!buffer) {
 			LOG_ERROR("Out of memory for flash bank buffer");
-			retval = ERROR_FAIL;
-			goto done;
+			return ERROR_FAIL;
 		}
 
 		if (padding_at_start)
@@ -918,87 +958,365 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 			size_t size_read;
 
 			size_read = run_size - buffer_idx;
-			if (size_read > sections[section]->size - section_offset)
-				size_read = sections[section]->size - section_offset;
+			if (size_read > sections[it->section]->size - it->section_offset)
+				size_read = sections[it->section]->size - it->section_offset;
 
-			/* KLUDGE!
-			 *
-			 * #¤%#"%¤% we have to figure out the section # from the sorted
-			 * list of pointers to sections to invoke image_read_section()...
-			 */
-			intptr_t diff = (intptr_t)sections[section] - (intptr_t)image->sections;
-			int t_section_num = diff / sizeof(struct imagesection);
+			int t_section_num = flash_write_section_num(it);
 
 			LOG_DEBUG("image_read_section: section = %d, t_section_num = %d, "
 					"section_offset = %"PRIu32", buffer_idx = %"PRIu32", size_read = %zu",
-				section, t_section_num, section_offset,
+				it->section, t_section_num, it->section_offset,
 				buffer_idx, size_read);
-			retval = image_read_section(image, t_section_num, section_offset,
+			retval = image_read_section(image, t_section_num, it->section_offset,
 					size_read, buffer + buffer_idx, &size_read);
 			if (retval != ERROR_OK || size_read == 0) {
 				free(buffer);
-				goto done;
+				return retval;
 			}
 
 			buffer_idx += size_read;
-			section_offset += size_read;
+			it->section_offset += size_read;
 
 			/* see if we need to pad the section */
-			if (padding[section]) {
-				memset(buffer + buffer_idx, c->default_padded_value, padding[section]);
-				buffer_idx += padding[section];
+			if (padding[it->section]) {
+				memset(buffer + buffer_idx, c->default_padded_value, padding[it->section]);
+				buffer_idx += padding[it->section];
 			}
 
-			if (section_offset >= sections[section]->size) {
-				section++;
-				section_offset = 0;
+			if (it->section_offset >= sections[it->section]->size) {
+				it->section++;
+				it->section_offset = 0;
 			}
 		}
 
-		retval = ERROR_OK;
+		run->bank = c;
+		run->address = run_address;
+		run->size = run_size;
+		run->buffer = buffer;
+		run->alloc = buffer;
+		break;
+	}
 
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
+	return ERROR_OK;
+}
+
+static void flash_write_stage_end(struct duration *bench, float *stage_time)
+{
+	if (duration_measure(bench) == ERROR_OK)
+		*stage_time += duration_elapsed(bench);
+}
+
+static bool flash_write_runs_adjacent(const struct flash_write_run *run,
+		const struct flash_write_run *next)
+{
+	return next->bank == run->bank && next->address == run->address + run->size;
+}
+
+/**
+ * Unlock, erase, write and verify runs which follow each other in a bank.
+ * The unlock and the erase of all the runs are single calls to the driver.
+ */
+static int flash_write_runs(struct target *target,
+		const struct flash_write_run *runs, unsigned int num_runs,
+		bool erase, bool unlock, bool write, bool verify,
+		struct flash_write_timing *timing)
+{
+	const struct flash_write_run *last = &runs[num_runs - 1];
+	target_addr_t address = runs[0].address;
+	uint32_t size = last->address + last->size - address;
+	struct duration bench;
+	int retval = ERROR_OK;
+
+	if (unlock) {
+		duration_start(&bench);
+		retval = flash_unlock_address_range(target, address, size);
+		flash_write_stage_end(&bench, &timing->unlock);
+	}
+
+	if (retval == ERROR_OK && erase) {
+		/* calculate and erase sectors */
+		duration_start(&bench);
+		retval = flash_erase_address_range(target, true, address, size);
+		flash_write_stage_end(&bench, &timing->erase);
+	}
+
+	if (retval == ERROR_OK && write) {
+		/* write flash sectors */
+		duration_start(&bench);
+		for (unsigned int i = 0; i < num_runs && retval == ERROR_OK; i++)
+			retval = flash_driver_write(runs[i].bank, runs[i].buffer,
+					runs[i].address - runs[i].bank->base, runs[i].size);
+		flash_write_stage_end(&bench, &timing->write);
+	}
+
+	if (retval == ERROR_OK && verify) {
+		/* verify flash sectors */
+		duration_start(&bench);
+		for (unsigned int i = 0; i < num_runs && retval == ERROR_OK; i++)
+			retval = flash_driver_verify(runs[i].bank, runs[i].buffer,
+					runs[i].address - runs[i].bank->base, runs[i].size);
+		flash_write_stage_end(&bench, &timing->verify);
+	}
+
+	return retval;
+}
+
+/**
+ * Check whether the flash content at offset in the bank already matches
+ * the buffer. Flash mapped in the target address space is compared by CRC,
+ * computed on the target when the target supports it. Banks with a custom
+ * verify function are read back through the driver and compared on host.
+ */
+static int flash_range_matches(struct flash_bank *bank,
+		const uint8_t *buffer, uint32_t offset, uint32_t count, bool *match)
+{
+	int retval;
+
+	*match = false;
+
+	if (bank->driver->verify) {
+		uint8_t *data = malloc(count);
+		if (!data) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
 		}
 
-		if (retval == ERROR_OK) {
-			if (write) {
-				/* write flash sectors */
-				retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
-			}
+		retval = flash_driver_read(bank, data, offset, count);
+		if (retval == ERROR_OK)
+			*match = memcmp(data, buffer, count) == 0;
+		free(data);
+		return retval;
+	}
+
+	uint32_t target_crc, image_crc;
+
+	retval = image_calculate_checksum(buffer, count, &image_crc);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = target_checksum_memory(bank->target, bank->base + offset, count, &target_crc);
+	if (retval != ERROR_OK)
+		return retval;
+
+	*match = target_crc == image_crc;
+	return ERROR_OK;
+}
+
+/**
+ * Like flash_write_runs(), but every sector touched by the run is first
+ * compared against the image. Only the ranges of consecutive sectors which
+ * differ are unlocked, erased, written and verified.
+ */
+static int flash_write_run_incremental(struct target *target, struct flash_write_run *run,
+		bool erase, bool unlock, bool verify, unsigned int *skipped,
+		struct flash_write_timing *timing)
+{
+	struct flash_bank *c = run->bank;
+	uint32_t run_offset = run->address - c->base;
+	uint32_t run_end = run_offset + run->size;
+	/* pending range of differing sectors, as offsets in the bank */
+	uint32_t dirty_start = 0, dirty_end = 0;
+	int retval = ERROR_OK;
+
+	if (c->num_sectors == 0)
+		return flash_write_runs(target, run, 1, erase, unlock, true, verify, timing);
+
+	for (unsigned int i = 0; i <= c->num_sectors && retval == ERROR_OK; i++) {
+		bool match = true;
+		uint32_t start = run_end, end = run_end;
+
+		if (i < c->num_sectors) {
+			struct flash_sector *sector = &c->sectors[i];
+			start = MAX(sector->offset, run_offset);
+			end = MIN(sector->offset + sector->size, run_end);
+			if (start >= end)
+				continue;
+
+			retval = flash_range_matches(c, run->buffer + (start - run_offset),
+					start, end - start, &match);
+			if (retval != ERROR_OK)
+				break;
 		}
 
-		if (retval == ERROR_OK) {
-			if (verify) {
-				/* verify flash sectors */
-				retval = flash_driver_verify(c, buffer, run_address - c->base, run_size);
+		if (!match) {
+			if (dirty_start == dirty_end)
+				dirty_start = start;
+			dirty_end = end;
+			continue;
+		}
+
+		if (i < c->num_sectors) {
+			LOG_DEBUG("sector %u of bank %s unchanged, skipped", i, c->name);
+			(*skipped)++;
+		}
+
+		if (dirty_start != dirty_end) {
+			struct flash_write_run dirty = {
+				.bank = c,
+				.address = c->base + dirty_start,
+				.size = dirty_end - dirty_start,
+				.buffer = run->buffer + (dirty_start - run_offset),
+			};
+			retval = flash_write_runs(target, &dirty, 1, erase, unlock, true, verify, timing);
+			dirty_start = dirty_end = 0;
+		}
+	}
+
+	return retval;
+}
+
+static int flash_write_image_runs(struct target *target, struct image *image,
+	uint32_t *written, bool erase, bool unlock, bool write, bool verify,
+	bool incremental, unsigned int *skipped, struct flash_write_timing *timing)
+{
+	int retval = ERROR_OK;
+	struct flash_write_run *runs = NULL;
+	unsigned int runs_alloc = 0;
+	/* run read ahead which does not follow the previous ones */
+	struct flash_write_run next;
+	bool next_valid = false;
+	struct flash_write_timing unused_timing;
+	unsigned int unused_skipped;
+	struct duration bench;
+
+	if (!timing)
+		timing = &unused_timing;
+	memset(timing, 0, sizeof(*timing));
+	if (!skipped)
+		skipped = &unused_skipped;
+	*skipped = 0;
+
+	/* allocate padding array */
+	int *padding = calloc(image->num_sections, sizeof(*padding));
+
+	/* This fn requires all sections to be in ascending order of addresses,
+	 * whereas an image can have sections out of order. */
+	struct imagesection **sections = malloc(sizeof(struct imagesection *) *
+			image->num_sections);
+
+	if (!padding || !sections) {
+		LOG_ERROR("Out of memory");
+		free(padding);
+		free(sections);
+		return ERROR_FAIL;
+	}
+
+	if (written)
+		*written = 0;
+
+	if (erase) {
+		/* assume all sectors need erasing - stops any problems
+		 * when flash_write is called multiple times */
+
+		flash_set_dirty();
+	}
+
+	for (unsigned int i = 0; i < image->num_sections; i++)
+		sections[i] = &image->sections[i];
+
+	qsort(sections, image->num_sections, sizeof(struct imagesection *),
+		compare_section);
+
+	struct flash_write_iter it = {
+		.target = target,
+		.image = image,
+		.sections = sections,
+		.padding = padding,
+	};
+
+	while (retval == ERROR_OK) {
+		unsigned int num_runs = 0;
+
+		/* runs which follow each other in a bank, typically runs padded to
+		 * the end of their last sector, are unlocked and erased together */
+		for (;;) {
+			struct flash_write_run run;
+
+			if (next_valid) {
+				run = next;
+				next_valid = false;
+			} else {
+				duration_start(&bench);
+				retval = flash_write_next_run(&it, erase, unlock, &run);
+				flash_write_stage_end(&bench, &timing->read);
+				if (retval != ERROR_OK || !run.buffer)
+					break;
+			}
+
+			if (num_runs > 0 && (incremental || !(erase || unlock) ||
+					!flash_write_runs_adjacent(&runs[num_runs - 1], &run))) {
+				next = run;
+				next_valid = true;
+				break;
+			}
+
+			if (num_runs == runs_alloc) {
+				unsigned int new_alloc = runs_alloc ? 2 * runs_alloc : 4;
+				struct flash_write_run *new_runs = realloc(runs, new_alloc * sizeof(*runs));
+				if (!new_runs) {
+					LOG_ERROR("Out of memory");
+					free(run.alloc);
+					retval = ERROR_FAIL;
+					break;
+				}
+				runs = new_runs;
+				runs_alloc = new_alloc;
 			}
+			runs[num_runs++] = run;
 		}
 
-		free(buffer);
+		if (num_runs == 0)
+			break;
 
-		if (retval != ERROR_OK) {
-			/* abort operation */
-			goto done;
+		if (retval == ERROR_OK) {
+			if (incremental)
+				retval = flash_write_run_incremental(target, &runs[0], erase, unlock,
+						verify, skipped, timing);
+			else
+				retval = flash_write_runs(target, runs, num_runs, erase, unlock,
+						write, verify, timing);
 		}
 
-		if (written)
-			*written += run_size;	/* add run size to total written counter */
+		for (unsigned int i = 0; i < num_runs; i++) {
+			/* add run size to total written counter */
+			if (retval == ERROR_OK && written)
+				*written += runs[i].size;
+			free(runs[i].alloc);
+		}
 	}
 
-done:
+	if (next_valid)
+		free(next.alloc);
+	free(runs);
 	free(sections);
 	free(padding);
 
 	return retval;
 }
 
+int flash_write_unlock_verify(struct target *target, struct image *image,
+	uint32_t *written, bool erase, bool unlock, bool write, bool verify)
+{
+	return flash_write_image_runs(target, image, written, erase, unlock,
+			write, verify, false, NULL, NULL);
+}
+
+int flash_write_timed(struct target *target, struct image *image,
+	uint32_t *written, bool erase, bool unlock,
+	struct flash_write_timing *timing)
+{
+	return flash_write_image_runs(target, image, written, erase, unlock,
+			true, false, false, NULL, timing);
+}
+
+int flash_write_incremental(struct target *target, struct image *image,
+	uint32_t *written, bool erase, bool unlock, bool verify,
+	unsigned int *skipped, struct flash_write_timing *timing)
+{
+	return flash_write_image_runs(target, image, written, erase, unlock,
+			true, verify, true, skipped, timing);
+}
+
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, bool erase)
 {
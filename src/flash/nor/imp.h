@@ -41,4 +41,33 @@ int flash_driver_verify(struct flash_bank *bank,
 int flash_write_unlock_verify(struct target *target, struct image *image,
 		uint32_t *written, bool erase, bool unlock, bool write, bool verify);
 
+/** Time in seconds spent in each stage of an image write */
+struct flash_write_timing {
+	/** reading and padding the image data */
+	float read;
+	float unlock;
+	float erase;
+	float write;
+	float verify;
+};
+
+/**
+ * Write an image to flash memory of the given target like
+ * flash_write_unlock_verify(), also returning the time spent in each stage.
+ */
+int flash_write_timed(struct target *target, struct image *image,
+		uint32_t *written, bool erase, bool unlock,
+		struct flash_write_timing *timing);
+
+/**
+ * Write (optional verify) an image to flash memory of the given target,
+ * skipping the sectors whose content already matches the image.
+ * The content is compared by CRC before any unlock or erase, then only
+ * the ranges of sectors which differ are processed.
+ * The number of sectors left untouched is returned in skipped.
+ */
+int flash_write_incremental(struct target *target, struct image *image,
+		uint32_t *written, bool erase, bool unlock, bool verify,
+		unsigned int *skipped, struct flash_write_timing *timing);
+
 #endif /* OPENOCD_FLASH_NOR_IMP_H */
@@ -401,6 +401,7 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	/* flash auto-erase is disabled by default*/
 	int auto_erase = 0;
 	bool auto_unlock = false;
+	bool incremental = false;
 
 	while (CMD_ARGC) {
 		if (strcmp(CMD_ARGV[0], "erase") == 0) {
@@ -413,6 +414,10 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD, "auto unlock enabled");
+		} else if (strcmp(CMD_ARGV[0], "incremental") == 0) {
+			incremental = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
 		} else
 			break;
 	}
@@ -442,8 +447,14 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = flash_write_unlock_verify(target, &image, &written, auto_erase,
-		auto_unlock, true, false);
+	struct flash_write_timing timing;
+	unsigned int skipped = 0;
+	if (incremental)
+		retval = flash_write_incremental(target, &image, &written, auto_erase,
+			auto_unlock, false, &skipped, &timing);
+	else
+		retval = flash_write_timed(target, &image, &written, auto_erase,
+			auto_unlock, &timing);
 	if (retval != ERROR_OK) {
 		image_close(&image);
 		return retval;
@@ -455,6 +466,12 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			duration_elapsed(&bench), duration_kbps(&bench, written));
 	}
 
+	command_print(CMD, "read %fs, unlock %fs, erase %fs, write %fs",
+		timing.read, timing.unlock, timing.erase, timing.write);
+
+	if (incremental)
+		command_print(CMD, "skipped %u unchanged sectors", skipped);
+
 	image_close(&image);
 
 	return retval;
@@ -1308,10 +1325,13 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.name = "write_image",
 		.handler = handle_flash_write_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "[erase] [unlock] filename [offset [file_type]]",
+		.usage = "[erase] [unlock] [incremental] filename [offset [file_type]]",
 		.help = "Write an image to flash.  Optionally first unprotect "
 			"and/or erase the region to be used. Allow optional "
-			"offset from beginning of bank (defaults to zero)",
+			"offset from beginning of bank (defaults to zero). "
+			"The time spent in each stage is reported. "
+			"With 'incremental' the sectors already matching "
+			"the image are skipped",
 	},
 	{
 		.name = "verify_image",
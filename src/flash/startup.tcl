@@ -104,6 +104,36 @@ proc program {filename args} {
 add_help_text program "write an image to flash, address is only required for binary images. preverify, verify, reset, exit are optional"
 add_usage_text program "<filename> \[address\] \[preverify\] \[verify\] \[reset\] \[exit\]"
 
+# Write an image to the flash of each of several targets, one after the
+# other, each given as a list {target filename [offset [type]]}
+proc "flash write_image_multi" {args} {
+	set flags {}
+	while {[llength $args] > 0 && [lindex $args 0] in {erase unlock}} {
+		lappend flags [lindex $args 0]
+		set args [lrange $args 1 end]
+	}
+	if {[llength $args] == 0} {
+		return -code error "flash write_image_multi: no image given"
+	}
+
+	set current [target current]
+	set code [catch {
+		foreach job $args {
+			if {[llength $job] < 2} {
+				error "flash write_image_multi: '$job' is not {target filename ...}"
+			}
+			targets [lindex $job 0]
+			echo "[lindex $job 0]: [flash write_image {*}$flags {*}[lrange $job 1 end]]"
+		}
+	} result]
+	targets $current
+
+	return -code $code $result
+}
+
+add_help_text "flash write_image_multi" "write an image to the flash of each of several targets, one after the other"
+add_usage_text "flash write_image_multi" "\[erase\] \[unlock\] {target filename \[offset \[file_type\]\]} ..."
+
 # stm32[f0x|f3x] uses the same flash driver as the stm32f1x
 proc stm32f0x args { eval stm32f1x $args }
 proc stm32f3x args { eval stm32f1x $args }
@@ -40,6 +40,14 @@ static const char hex_digits[] = {
 	'a', 'b', 'c', 'd', 'e', 'f'
 };
 
+/* value + 1 of each hexadecimal digit, 0 for any other character */
+static const uint8_t hex_values[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
 void *buf_cpy(const void *from, void *_to, unsigned int size)
 {
 	if (!from || !_to)
@@ -341,28 +349,27 @@ void bit_copy_discard(struct bit_copy_queue *q)
  */
 size_t unhexify(uint8_t *bin, const char *hex, size_t count)
 {
-	size_t i;
-	char tmp;
-
 	if (!bin || !hex)
 		return 0;
 
-	memset(bin, 0, count);
+	const unsigned char *h = (const unsigned char *)hex;
 
-	for (i = 0; i < 2 * count; i++) {
-		if (hex[i] >= 'a' && hex[i] <= 'f')
-			tmp = hex[i] - 'a' + 10;
-		else if (hex[i] >= 'A' && hex[i] <= 'F')
-			tmp = hex[i] - 'A' + 10;
-		else if (hex[i] >= '0' && hex[i] <= '9')
-			tmp = hex[i] - '0';
-		else
-			return i / 2;
+	for (size_t i = 0; i < count; i++) {
+		uint8_t high = hex_values[h[2 * i]];
+		uint8_t low = high ? hex_values[h[2 * i + 1]] : 0;
+
+		if (!low) {
+			/* keep the high nibble of an incomplete pair */
+			memset(bin + i, 0, count - i);
+			if (high)
+				bin[i] = (high - 1) << 4;
+			return i;
+		}
 
-		bin[i / 2] |= tmp << (4 * ((i + 1) % 2));
+		bin[i] = (high - 1) << 4 | (low - 1);
 	}
 
-	return i / 2;
+	return count;
 }
 
 /**
@@ -379,17 +386,23 @@ size_t unhexify(uint8_t *bin, const char *hex, size_t count)
  */
 size_t hexify(char *hex, const uint8_t *bin, size_t count, size_t length)
 {
-	size_t i;
-	uint8_t tmp;
-
 	if (!length)
 		return 0;
 
-	for (i = 0; i < length - 1 && i < 2 * count; i++) {
-		tmp = (bin[i / 2] >> (4 * ((i + 1) % 2))) & 0x0f;
-		hex[i] = hex_digits[tmp];
+	/* whole bytes which fit in the output, leaving room for the NUL */
+	size_t bytes = MIN(count, (length - 1) / 2);
+	size_t i;
+
+	for (i = 0; i < bytes; i++) {
+		hex[2 * i] = hex_digits[bin[i] >> 4];
+		hex[2 * i + 1] = hex_digits[bin[i] & 0x0f];
 	}
 
+	i *= 2;
+	/* odd length, only the high nibble of the next byte fits */
+	if (bytes < count && i < length - 1)
+		hex[i++] = hex_digits[bin[bytes] >> 4];
+
 	hex[i] = 0;
 
 	return i;
@@ -13,38 +13,108 @@
 #endif
 
 #include "crc32.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
-static uint32_t crc_le_step(uint32_t poly, uint32_t crc, uint32_t data_in,
-		unsigned int data_bits)
+/* Tables for the slice-by-8 algorithm, built for the last polynomial used */
+struct crc32_tables {
+	uint32_t poly;
+	bool valid;
+	uint32_t table[8][256];
+};
+
+static struct crc32_tables crc32_le_tables;
+static struct crc32_tables crc32_be_tables;
+
+static const uint32_t (*crc32_le_get_tables(uint32_t poly))[256]
 {
-	for (unsigned int i = 0; i < data_bits; i++) {
-		uint32_t d, c;
-		d = ((data_in >> i) & 0x1) ? 0xffffffff : 0;
-		c = (crc & 0x1) ? 0xffffffff : 0;
-		crc = crc >> 1;
-		crc = crc ^ ((d ^ c) & poly);
+	struct crc32_tables *t = &crc32_le_tables;
+
+	if (t->valid && t->poly == poly)
+		return t->table;
+
+	for (unsigned int i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (unsigned int j = 0; j < 8; j++)
+			crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+		t->table[0][i] = crc;
 	}
+	for (unsigned int i = 0; i < 256; i++)
+		for (unsigned int k = 1; k < 8; k++)
+			t->table[k][i] = (t->table[k - 1][i] >> 8)
+				^ t->table[0][t->table[k - 1][i] & 0xff];
 
-	return crc;
+	t->poly = poly;
+	t->valid = true;
+	return t->table;
+}
+
+static const uint32_t (*crc32_be_get_tables(uint32_t poly))[256]
+{
+	struct crc32_tables *t = &crc32_be_tables;
+
+	if (t->valid && t->poly == poly)
+		return t->table;
+
+	for (unsigned int i = 0; i < 256; i++) {
+		uint32_t crc = i << 24;
+		for (unsigned int j = 0; j < 8; j++)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ poly : crc << 1;
+		t->table[0][i] = crc;
+	}
+	for (unsigned int i = 0; i < 256; i++)
+		for (unsigned int k = 1; k < 8; k++)
+			t->table[k][i] = (t->table[k - 1][i] << 8)
+				^ t->table[0][t->table[k - 1][i] >> 24];
+
+	t->poly = poly;
+	t->valid = true;
+	return t->table;
 }
 
 uint32_t crc32_le(uint32_t poly, uint32_t seed, const void *_data,
 		size_t data_len)
 {
-	if (((uintptr_t)_data & 0x3) || (data_len & 0x3)) {
-		/* data is unaligned, processing data one byte at a time */
-		const uint8_t *data = _data;
-		for (size_t i = 0; i < data_len; i++)
-			seed = crc_le_step(poly, seed, data[i], 8);
-	} else {
-		/* data is aligned, processing 32 bit at a time */
-		data_len >>= 2;
-		const uint32_t *data = _data;
-		for (size_t i = 0; i < data_len; i++)
-			seed = crc_le_step(poly, seed, data[i], 32);
+	const uint32_t (*t)[256] = crc32_le_get_tables(poly);
+	const uint8_t *data = _data;
+	uint32_t crc = seed;
+
+	/* slice-by-8: process 8 bytes with 8 table lookups */
+	for (; data_len >= 8; data_len -= 8, data += 8) {
+		crc ^= (uint32_t)data[0] | (uint32_t)data[1] << 8
+			| (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+		crc = t[7][crc & 0xff] ^ t[6][(crc >> 8) & 0xff]
+			^ t[5][(crc >> 16) & 0xff] ^ t[4][crc >> 24]
+			^ t[3][data[4]] ^ t[2][data[5]]
+			^ t[1][data[6]] ^ t[0][data[7]];
+	}
+
+	while (data_len--)
+		crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+
+	return crc;
+}
+
+uint32_t crc32_be(uint32_t poly, uint32_t seed, const void *_data,
+		size_t data_len)
+{
+	const uint32_t (*t)[256] = crc32_be_get_tables(poly);
+	const uint8_t *data = _data;
+	uint32_t crc = seed;
+
+	/* slice-by-8: process 8 bytes with 8 table lookups */
+	for (; data_len >= 8; data_len -= 8, data += 8) {
+		crc ^= (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16
+			| (uint32_t)data[2] << 8 | (uint32_t)data[3];
+		crc = t[7][crc >> 24] ^ t[6][(crc >> 16) & 0xff]
+			^ t[5][(crc >> 8) & 0xff] ^ t[4][crc & 0xff]
+			^ t[3][data[4]] ^ t[2][data[5]]
+			^ t[1][data[6]] ^ t[0][data[7]];
 	}
 
-	return seed;
+	while (data_len--)
+		crc = (crc << 8) ^ t[0][(crc >> 24) ^ *data++];
+
+	return crc;
 }
@@ -21,7 +21,12 @@
 #define CRC32_POLY_LE	0xedb88320
 
 /**
- * Calculate the CRC32 value of the given data
+ * CRC32 polynomial used by GDB and by the target checksum algorithms
+ */
+#define CRC32_POLY_BE	0x04c11db7
+
+/**
+ * Calculate the CRC32 value of the given data, least significant bit first
  * @param	poly		The polynomial of the CRC
  * @param	seed		The seed to use (mostly either `0` or `0xffffffff`)
  * @param	data		The data to calculate the CRC32 of
@@ -34,4 +39,16 @@
 uint32_t crc32_le(uint32_t poly, uint32_t seed, const void *data,
 		size_t data_len);
 
+/**
+ * Calculate the CRC32 value of the given data, most significant bit first
+ * @param	poly		The polynomial of the CRC, e.g. CRC32_POLY_BE
+ * @param	seed		The seed to use (mostly either `0` or `0xffffffff`)
+ * @param	data		The data to calculate the CRC32 of
+ * @param	data_len	The length of the data in @p data in bytes
+ * @return	The CRC value of the first @p data_len bytes at @p data
+ * @note	As for crc32_le(), the CRC can be computed incrementally.
+ */
+uint32_t crc32_be(uint32_t poly, uint32_t seed, const void *data,
+		size_t data_len);
+
 #endif /* OPENOCD_HELPER_CRC32_H */
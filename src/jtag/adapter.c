@@ -204,6 +204,8 @@ int adapter_quit(void)
 	free(adapter_config.usb_location);
 	free(adapter_config.product_name);
 
+	jtag_command_queue_free();
+
 	struct jtag_tap *t = jtag_all_taps();
 	while (t) {
 		struct jtag_tap *n = t->next_tap;
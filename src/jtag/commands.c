@@ -21,18 +21,36 @@
 
 #include <jtag/jtag.h>
 #include <transport/transport.h>
+#include <helper/align.h>
 #include "commands.h"
 
+/*
+ * Memory for queued commands comes from an arena of pages. The pages are not
+ * released when the queue is flushed, they are recycled by the next queue so
+ * that flushing thousands of times per second does not churn malloc().
+ * Only pages bigger than CMD_QUEUE_PAGE_SIZE, allocated for a single large
+ * request, are freed on flush.
+ */
 struct cmd_queue_page {
 	struct cmd_queue_page *next;
 	void *address;
+	size_t size;
 	size_t used;
+	/* value of cmd_queue_generation when the page was last used */
+	unsigned int generation;
 };
 
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
+/* all the pages owned by the arena */
 static struct cmd_queue_page *cmd_queue_pages;
+/* the page currently being filled, pages after it are unused */
 static struct cmd_queue_page *cmd_queue_pages_tail;
 
+/* incremented on each flush of the queue */
+static unsigned int cmd_queue_generation;
+
+static struct cmd_queue_stats cmd_queue_stats;
+
 static struct jtag_command *jtag_command_queue;
 static struct jtag_command **next_command_pointer = &jtag_command_queue;
 
@@ -63,65 +81,122 @@ void jtag_queue_command(struct jtag_command *cmd)
 	next_command_pointer = &cmd->next;
 }
 
+/*
+ * Pointers returned by cmd_queue_alloc() must have the same alignment as
+ * the ones from malloc(). max_align_t is only available from C11 on, the
+ * union is a reasonable approximation for older compilers.
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define CMD_QUEUE_ALIGN _Alignof(max_align_t)
+#else
+union cmd_queue_worst_case_align {
+	long long ll;
+	long double ld;
+	void *v;
+	void (*f)(void);
+};
+#define CMD_QUEUE_ALIGN offsetof(struct { char c; union cmd_queue_worst_case_align u; }, u)
+#endif
+
+static struct cmd_queue_page *cmd_queue_page_alloc(size_t size)
+{
+	struct cmd_queue_page *page = malloc(sizeof(*page));
+	if (!page)
+		return NULL;
+
+	page->size = MAX(size, (size_t)CMD_QUEUE_PAGE_SIZE);
+	page->address = malloc(page->size);
+	if (!page->address) {
+		free(page);
+		return NULL;
+	}
+	page->used = 0;
+	page->generation = cmd_queue_generation;
+	page->next = NULL;
+
+	cmd_queue_stats.pages_allocated++;
+	cmd_queue_stats.pages++;
+
+	return page;
+}
+
 void *cmd_queue_alloc(size_t size)
 {
-	struct cmd_queue_page **p_page = &cmd_queue_pages;
-	int offset;
-	uint8_t *t;
-
-	/*
-	 * WARNING:
-	 *    We align/round the *SIZE* per below
-	 *    so that all pointers returned by
-	 *    this function are reasonably well
-	 *    aligned.
-	 *
-	 * If we did not, then an "odd-length" request would cause the
-	 * *next* allocation to be at an *odd* address, and because
-	 * this function has the same type of api as malloc() - we
-	 * must also return pointers that have the same type of
-	 * alignment.
-	 *
-	 * What I do not/have is a reasonable portable means
-	 * to align by...
-	 *
-	 * The solution here, is based on these suggestions.
-	 * http://gcc.gnu.org/ml/gcc-help/2008-12/msg00041.html
-	 *
-	 */
-	union worse_case_align {
-		int i;
-		long l;
-		float f;
-		void *v;
-	};
-#define ALIGN_SIZE  (sizeof(union worse_case_align))
-
-	/* The alignment process. */
-	size = (size + ALIGN_SIZE - 1) & (~(ALIGN_SIZE - 1));
-	/* Done... */
-
-	if (*p_page) {
-		p_page = &cmd_queue_pages_tail;
-		if (CMD_QUEUE_PAGE_SIZE < (*p_page)->used + size)
-			p_page = &((*p_page)->next);
+	struct cmd_queue_page *page = cmd_queue_pages_tail;
+
+	/* round the size so the next allocation is aligned too */
+	size = ALIGN_UP(size, CMD_QUEUE_ALIGN);
+
+	if (!page || page->size - page->used < size) {
+		struct cmd_queue_page *next = page ? page->next : cmd_queue_pages;
+
+		if (!next || next->size < size) {
+			struct cmd_queue_page *new_page = cmd_queue_page_alloc(size);
+			if (!new_page) {
+				LOG_ERROR("Out of memory");
+				return NULL;
+			}
+			new_page->next = next;
+			if (page)
+				page->next = new_page;
+			else
+				cmd_queue_pages = new_page;
+			next = new_page;
+		}
+
+		page = next;
+		cmd_queue_pages_tail = page;
 	}
 
-	if (!*p_page) {
-		*p_page = malloc(sizeof(struct cmd_queue_page));
-		(*p_page)->used = 0;
-		size_t alloc_size = (size < CMD_QUEUE_PAGE_SIZE) ?
-					CMD_QUEUE_PAGE_SIZE : size;
-		(*p_page)->address = malloc(alloc_size);
-		(*p_page)->next = NULL;
-		cmd_queue_pages_tail = *p_page;
+	/* first use of a page left over by a previous queue */
+	if (!page->used && page->generation != cmd_queue_generation)
+		cmd_queue_stats.pages_reused++;
+	page->generation = cmd_queue_generation;
+
+	uint8_t *t = page->address;
+	t += page->used;
+	page->used += size;
+
+	cmd_queue_stats.allocations++;
+	cmd_queue_stats.bytes_allocated += size;
+
+	return t;
+}
+
+/* Recycle the pages for the next queue, only drop the oversized ones */
+static void cmd_queue_recycle(void)
+{
+	struct cmd_queue_page **p_page = &cmd_queue_pages;
+	unsigned int pages_used = 0;
+	size_t queue_bytes = 0;
+
+	while (*p_page) {
+		struct cmd_queue_page *page = *p_page;
+
+		if (page->used) {
+			pages_used++;
+			queue_bytes += page->used;
+		}
+
+		if (page->size > CMD_QUEUE_PAGE_SIZE) {
+			*p_page = page->next;
+			free(page->address);
+			free(page);
+			cmd_queue_stats.pages--;
+			continue;
+		}
+
+		page->used = 0;
+		p_page = &page->next;
 	}
 
-	offset = (*p_page)->used;
-	(*p_page)->used += size;
+	cmd_queue_pages_tail = cmd_queue_pages;
+	cmd_queue_generation++;
 
-	t = (*p_page)->address;
-	return t + offset;
+	if (pages_used > cmd_queue_stats.pages_high_water)
+		cmd_queue_stats.pages_high_water = pages_used;
+	if (queue_bytes > cmd_queue_stats.queue_bytes_high_water)
+		cmd_queue_stats.queue_bytes_high_water = queue_bytes;
 }
 
 static void cmd_queue_free(void)
@@ -137,16 +212,36 @@ static void cmd_queue_free(void)
 
 	cmd_queue_pages = NULL;
 	cmd_queue_pages_tail = NULL;
+	cmd_queue_stats.pages = 0;
+}
+
+void cmd_queue_get_stats(struct cmd_queue_stats *stats)
+{
+	*stats = cmd_queue_stats;
+}
+
+void cmd_queue_reset_stats(void)
+{
+	unsigned int pages = cmd_queue_stats.pages;
+
+	memset(&cmd_queue_stats, 0, sizeof(cmd_queue_stats));
+	cmd_queue_stats.pages = pages;
 }
 
 void jtag_command_queue_reset(void)
 {
-	cmd_queue_free();
+	cmd_queue_recycle();
 
 	jtag_command_queue = NULL;
 	next_command_pointer = &jtag_command_queue;
 }
 
+void jtag_command_queue_free(void)
+{
+	jtag_command_queue_reset();
+	cmd_queue_free();
+}
+
 struct jtag_command *jtag_command_queue_get(void)
 {
 	return jtag_command_queue;
@@ -149,10 +149,31 @@ struct jtag_command {
 	struct jtag_command *next;
 };
 
+/** Usage statistics of the memory backing the JTAG command queue. */
+struct cmd_queue_stats {
+	/** number of cmd_queue_alloc() calls */
+	uint64_t allocations;
+	/** bytes handed out by cmd_queue_alloc(), including alignment */
+	uint64_t bytes_allocated;
+	/** pages obtained from malloc() */
+	uint64_t pages_allocated;
+	/** pages recycled from a previous queue instead of malloc() */
+	uint64_t pages_reused;
+	/** pages currently held between flushes */
+	unsigned int pages;
+	/** largest number of pages used by a single queue */
+	unsigned int pages_high_water;
+	/** largest number of bytes used by a single queue */
+	size_t queue_bytes_high_water;
+};
+
 void *cmd_queue_alloc(size_t size);
+void cmd_queue_get_stats(struct cmd_queue_stats *stats);
+void cmd_queue_reset_stats(void);
 
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
+void jtag_command_queue_free(void);
 struct jtag_command *jtag_command_queue_get(void);
 
 void jtag_scan_field_clone(struct scan_field *dst, const struct scan_field *src);
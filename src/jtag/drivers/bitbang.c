@@ -72,6 +72,14 @@ static int bitbang_state_move(int skip)
 	uint8_t tms_scan = tap_get_tms_path(tap_get_state(), tap_get_end_state());
 	int tms_count = tap_get_tms_path_len(tap_get_state(), tap_get_end_state());
 
+	if (bitbang_interface->tms_seq) {
+		uint8_t bits = tms_scan >> skip;
+		if (bitbang_interface->tms_seq(&bits, MAX(tms_count - skip, 0)) != ERROR_OK)
+			return ERROR_FAIL;
+		tap_set_state(tap_get_end_state());
+		return ERROR_OK;
+	}
+
 	for (i = skip; i < tms_count; i++) {
 		tms = (tms_scan >> i) & 1;
 		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
@@ -97,6 +105,9 @@ static int bitbang_execute_tms(struct jtag_command *cmd)
 
 	LOG_DEBUG_IO("TMS: %u bits", num_bits);
 
+	if (bitbang_interface->tms_seq)
+		return bitbang_interface->tms_seq(bits, num_bits);
+
 	int tms = 0;
 	for (unsigned int i = 0; i < num_bits; i++) {
 		tms = ((bits[i/8] >> (i % 8)) & 1);
@@ -159,14 +170,19 @@ static int bitbang_runtest(unsigned int num_cycles)
 	}
 
 	/* execute num_cycles */
-	for (unsigned int i = 0; i < num_cycles; i++) {
-		if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
+	if (bitbang_interface->tms_seq) {
+		if (bitbang_interface->tms_seq(NULL, num_cycles) != ERROR_OK)
 			return ERROR_FAIL;
-		if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
+	} else {
+		for (unsigned int i = 0; i < num_cycles; i++) {
+			if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
+				return ERROR_FAIL;
+			if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+		if (bitbang_interface->write(CLOCK_IDLE(), 0, 0) != ERROR_OK)
 			return ERROR_FAIL;
 	}
-	if (bitbang_interface->write(CLOCK_IDLE(), 0, 0) != ERROR_OK)
-		return ERROR_FAIL;
 
 	/* finish in end_state */
 	bitbang_end_state(saved_end_state);
@@ -192,25 +208,11 @@ static int bitbang_stableclocks(unsigned int num_cycles)
 	return ERROR_OK;
 }
 
-static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
+static int bitbang_scan_bits(enum scan_type type, uint8_t *buffer,
 		unsigned int scan_size)
 {
-	enum tap_state saved_end_state = tap_get_end_state();
 	unsigned int bit_cnt;
 
-	if (!((!ir_scan &&
-			(tap_get_state() == TAP_DRSHIFT)) ||
-			(ir_scan && (tap_get_state() == TAP_IRSHIFT)))) {
-		if (ir_scan)
-			bitbang_end_state(TAP_IRSHIFT);
-		else
-			bitbang_end_state(TAP_DRSHIFT);
-
-		if (bitbang_state_move(0) != ERROR_OK)
-			return ERROR_FAIL;
-		bitbang_end_state(saved_end_state);
-	}
-
 	size_t buffered = 0;
 	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
 		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
@@ -270,6 +272,36 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		}
 	}
 
+	return ERROR_OK;
+}
+
+static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
+		unsigned int scan_size)
+{
+	enum tap_state saved_end_state = tap_get_end_state();
+
+	if (!((!ir_scan &&
+			(tap_get_state() == TAP_DRSHIFT)) ||
+			(ir_scan && (tap_get_state() == TAP_IRSHIFT)))) {
+		if (ir_scan)
+			bitbang_end_state(TAP_IRSHIFT);
+		else
+			bitbang_end_state(TAP_DRSHIFT);
+
+		if (bitbang_state_move(0) != ERROR_OK)
+			return ERROR_FAIL;
+		bitbang_end_state(saved_end_state);
+	}
+
+	if (bitbang_interface->scan) {
+		if (bitbang_interface->scan(type != SCAN_IN ? buffer : NULL,
+				type != SCAN_OUT ? buffer : NULL, scan_size) != ERROR_OK)
+			return ERROR_FAIL;
+	} else {
+		if (bitbang_scan_bits(type, buffer, scan_size) != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
 	if (tap_get_state() != tap_get_end_state()) {
 		/* we *KNOW* the above loop transitioned out of
 		 * the shift state, so we skip the first state
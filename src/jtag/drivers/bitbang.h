@@ -61,6 +61,18 @@ struct bitbang_interface {
 
 	/** Force a flush. */
 	int (*flush)(void);
+
+	/** Clock out num_bits of TMS, least significant bit first, with TDI low
+	 * (optional). A NULL bits pointer clocks out zeros. Equivalent to
+	 * write(0, tms, 0), write(1, tms, 0) for each bit, followed by
+	 * write(0, tms, 0) with the last TMS value. */
+	int (*tms_seq)(const uint8_t *bits, unsigned int num_bits);
+
+	/** Shift a whole scan vector (optional). Equivalent to write(0, tms, tdi),
+	 * sampling TDO and write(1, tms, tdi) for each bit, with TMS high on the
+	 * last bit only. tdi may be NULL to shift out zeros and tdo may be NULL
+	 * when nothing is captured; both may point to the same buffer. */
+	int (*scan)(const uint8_t *tdi, uint8_t *tdo, unsigned int num_bits);
 };
 
 extern const struct swd_driver bitbang_swd;
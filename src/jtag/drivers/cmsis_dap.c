@@ -243,17 +243,22 @@ static unsigned int pending_queue_len;
 static unsigned int tfer_max_command_size;
 static unsigned int tfer_max_response_size;
 
-/* pointers to buffers that will receive jtag scan results on the next flush */
-#define MAX_PENDING_SCAN_RESULTS 256
+/* pointers to buffers that will receive jtag scan results on the next flush,
+ * one per queued sequence at most */
 static int pending_scan_result_count;
-static struct pending_scan_result pending_scan_results[MAX_PENDING_SCAN_RESULTS];
+static struct pending_scan_result *pending_scan_results;
 
-/* queued JTAG sequences that will be executed on the next flush */
+/* queued JTAG sequences that will be executed on the next flush; the buffers
+ * are sized from the packet size once it is known */
 #define QUEUED_SEQ_BUF_LEN (cmsis_dap_handle->packet_usable_size - 3)
+#define QUEUED_SEQ_MAX_COUNT MIN(255, QUEUED_SEQ_BUF_LEN / 2)
 static int queued_seq_count;
 static int queued_seq_buf_end;
 static int queued_seq_tdo_ptr;
-static uint8_t queued_seq_buf[1024]; /* TODO: make dynamic / move into cmsis object */
+static uint8_t *queued_seq_buf;
+
+/* Limit of the pending request FIFO depth, see "cmsis-dap max_pending" */
+static unsigned int cmsis_dap_max_pending = MAX_PENDING_REQUESTS;
 
 static int queued_retval;
 
@@ -274,6 +279,10 @@ static int cmsis_dap_open(void)
 		return ERROR_FAIL;
 	}
 
+	/* packet_count is only read from the adapter once it is open, the
+	 * backends size their transfer slots from this bound */
+	dap->max_packet_count = cmsis_dap_max_pending;
+
 	int retval = ERROR_FAIL;
 	if (cmsis_dap_backend >= 0) {
 		/* Use forced backend */
@@ -320,11 +329,18 @@ static void cmsis_dap_close(struct cmsis_dap *dap)
 
 	free(dap->packet_buffer);
 
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
-		free(dap->pending_fifo[i].transfers);
-		dap->pending_fifo[i].transfers = NULL;
+	if (dap->pending_fifo) {
+		for (unsigned int i = 0; i < dap->packet_count; i++)
+			free(dap->pending_fifo[i].transfers);
+		free(dap->pending_fifo);
+		dap->pending_fifo = NULL;
 	}
 
+	free(queued_seq_buf);
+	queued_seq_buf = NULL;
+	free(pending_scan_results);
+	pending_scan_results = NULL;
+
 	free(cmsis_dap_handle);
 	cmsis_dap_handle = NULL;
 }
@@ -776,7 +792,7 @@ static int cmsis_dap_cmd_dap_swo_data(
 
 static void cmsis_dap_swd_discard_all_pending(struct cmsis_dap *dap)
 {
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++)
+	for (unsigned int i = 0; i < dap->packet_count; i++)
 		dap->pending_fifo[i].transfer_count = 0;
 
 	dap->pending_fifo_put_idx = 0;
@@ -882,6 +898,11 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 	if (dap->pending_fifo_block_count > packet_count)
 		LOG_ERROR("internal: too much pending writes %u", dap->pending_fifo_block_count);
 
+	dap->stats.packets++;
+	dap->stats.transfers += block->transfer_count;
+	dap->stats.depth_sum += dap->pending_fifo_block_count;
+	dap->stats.max_depth = MAX(dap->stats.max_depth, dap->pending_fifo_block_count);
+
 	return;
 
 skip:
@@ -1013,6 +1034,7 @@ static int cmsis_dap_swd_run_queue(void)
 	while (cmsis_dap_handle->pending_fifo_block_count)
 		cmsis_dap_swd_read_process(cmsis_dap_handle, CMSIS_DAP_BLOCKING);
 
+	cmsis_dap_handle->stats.runs++;
 	cmsis_dap_handle->pending_fifo_put_idx = 0;
 	cmsis_dap_handle->pending_fifo_get_idx = 0;
 
@@ -1093,8 +1115,10 @@ static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 		cmsis_dap_swd_write_from_queue(cmsis_dap_handle);
 
 		unsigned int packet_count = cmsis_dap_quirk_mode ? 1 : cmsis_dap_handle->packet_count;
-		if (cmsis_dap_handle->pending_fifo_block_count >= packet_count)
+		if (cmsis_dap_handle->pending_fifo_block_count >= packet_count) {
+			cmsis_dap_handle->stats.full_stalls++;
 			cmsis_dap_swd_read_process(cmsis_dap_handle, CMSIS_DAP_BLOCKING);
+		}
 	}
 
 	assert(cmsis_dap_handle->pending_fifo[cmsis_dap_handle->pending_fifo_put_idx].transfer_count < pending_queue_len);
@@ -1399,12 +1423,19 @@ static int cmsis_dap_init(void)
 	if (data[0] == 1) { /* byte */
 		unsigned int pkt_cnt = data[1];
 		if (pkt_cnt > 1)
-			cmsis_dap_handle->packet_count = MIN(MAX_PENDING_REQUESTS, pkt_cnt);
+			cmsis_dap_handle->packet_count = MIN(cmsis_dap_handle->max_packet_count, pkt_cnt);
 
 		LOG_DEBUG("CMSIS-DAP: Packet Count = %u", pkt_cnt);
 	}
 
 	LOG_DEBUG("Allocating FIFO for %u pending packets", cmsis_dap_handle->packet_count);
+	cmsis_dap_handle->pending_fifo = calloc(cmsis_dap_handle->packet_count,
+			sizeof(*cmsis_dap_handle->pending_fifo));
+	if (!cmsis_dap_handle->pending_fifo) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+		retval = ERROR_FAIL;
+		goto init_err;
+	}
 	for (unsigned int i = 0; i < cmsis_dap_handle->packet_count; i++) {
 		cmsis_dap_handle->pending_fifo[i].transfers = malloc(pending_queue_len
 									 * sizeof(struct pending_transfer_result));
@@ -1415,6 +1446,14 @@ static int cmsis_dap_init(void)
 		}
 	}
 
+	queued_seq_buf = malloc(QUEUED_SEQ_BUF_LEN);
+	pending_scan_results = calloc(QUEUED_SEQ_MAX_COUNT, sizeof(*pending_scan_results));
+	if (!queued_seq_buf || !pending_scan_results) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP JTAG sequences");
+		retval = ERROR_FAIL;
+		goto init_err;
+	}
+
 	/* Intentionally not checked for error, just logs an info message
 	 * not vital for further debugging */
 	(void)cmsis_dap_get_status();
@@ -1691,7 +1730,8 @@ static void cmsis_dap_add_jtag_sequence(unsigned int s_len, const uint8_t *seque
 	}
 
 	unsigned int cmd_len = 1 + DIV_ROUND_UP(s_len, 8);
-	if (queued_seq_count >= 255 || queued_seq_buf_end + cmd_len > QUEUED_SEQ_BUF_LEN)
+	if (queued_seq_count >= (int)QUEUED_SEQ_MAX_COUNT
+			|| queued_seq_buf_end + cmd_len > QUEUED_SEQ_BUF_LEN)
 		/* empty out the buffer */
 		cmsis_dap_flush();
 
@@ -2224,6 +2264,63 @@ COMMAND_HANDLER(cmsis_dap_handle_quirk_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cmsis_dap_handle_max_pending_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int max_pending;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], max_pending);
+		if (max_pending < 1 || max_pending > MAX_PENDING_REQUESTS_LIMIT) {
+			command_print(CMD, "max_pending must be between 1 and %u",
+					MAX_PENDING_REQUESTS_LIMIT);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		cmsis_dap_max_pending = max_pending;
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "%u", cmsis_dap_max_pending);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!cmsis_dap_handle) {
+		command_print(CMD, "CMSIS-DAP adapter is not initialized");
+		return ERROR_FAIL;
+	}
+
+	struct cmsis_dap_stats *stats = &cmsis_dap_handle->stats;
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "pending FIFO size:    %u", cmsis_dap_handle->packet_count);
+	command_print(CMD, "queue runs:           %" PRIu64, stats->runs);
+	command_print(CMD, "packets:              %" PRIu64, stats->packets);
+	command_print(CMD, "transfers:            %" PRIu64, stats->transfers);
+	if (stats->packets) {
+		command_print(CMD, "transfers per packet: %" PRIu64,
+				stats->transfers / stats->packets);
+		command_print(CMD, "average FIFO depth:   %" PRIu64 ".%02" PRIu64,
+				stats->depth_sum / stats->packets,
+				stats->depth_sum * 100 / stats->packets % 100);
+	}
+	command_print(CMD, "max FIFO depth:       %u", stats->max_depth);
+	command_print(CMD, "FIFO full stalls:     %" PRIu64, stats->full_stalls);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 	{
 		.name = "info",
@@ -2253,6 +2350,20 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.help = "allow expensive workarounds of known adapter quirks.",
 		.usage = "[enable | disable]",
 	},
+	{
+		.name = "max_pending",
+		.handler = &cmsis_dap_handle_max_pending_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the maximum number of packets sent before waiting for a response.",
+		.usage = "[count]",
+	},
+	{
+		.name = "stats",
+		.handler = &cmsis_dap_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show or reset the utilisation statistics of the pending packet FIFO.",
+		.usage = "['reset']",
+	},
 #if BUILD_CMSIS_DAP_USB
 	{
 		.name = "usb",
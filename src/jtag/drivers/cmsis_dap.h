@@ -14,9 +14,12 @@ struct pending_transfer_result {
 	void *buffer;
 };
 
-/* Up to MIN(packet_count, MAX_PENDING_REQUESTS) requests may be issued
- * until the first response arrives */
+/* Up to MIN(packet_count, max_pending) requests may be issued until the
+ * first response arrives. max_pending defaults to MAX_PENDING_REQUESTS and
+ * can be raised with "cmsis-dap max_pending" up to MAX_PENDING_REQUESTS_LIMIT,
+ * the largest packet count a probe can report. */
 #define MAX_PENDING_REQUESTS 4
+#define MAX_PENDING_REQUESTS_LIMIT 255
 
 struct pending_request_block {
 	struct pending_transfer_result *transfers;
@@ -24,6 +27,18 @@ struct pending_request_block {
 	uint8_t command;
 };
 
+/* Utilisation of the pending request FIFO, see "cmsis-dap stats" */
+struct cmsis_dap_stats {
+	uint64_t runs;
+	uint64_t packets;
+	uint64_t transfers;
+	/* Sum of the FIFO depth right after each packet was sent */
+	uint64_t depth_sum;
+	unsigned int max_depth;
+	/* Packets that had to wait for a response because the FIFO was full */
+	uint64_t full_stalls;
+};
+
 struct cmsis_dap {
 	struct cmsis_dap_backend_data *bdata;
 	const struct cmsis_dap_backend *backend;
@@ -45,11 +60,15 @@ struct cmsis_dap {
 	uint8_t common_swd_cmd;
 	bool swd_cmds_differ;
 
-	/* Pending requests are organized as a FIFO - circular buffer */
-	struct pending_request_block pending_fifo[MAX_PENDING_REQUESTS];
+	/* Pending requests are organized as a FIFO - circular buffer
+	 * of packet_count blocks */
+	struct pending_request_block *pending_fifo;
 	unsigned int packet_count;
+	/* Upper bound of packet_count, known when the backend is opened */
+	unsigned int max_packet_count;
 	unsigned int pending_fifo_put_idx, pending_fifo_get_idx;
 	unsigned int pending_fifo_block_count;
+	struct cmsis_dap_stats stats;
 
 	uint16_t caps;
 
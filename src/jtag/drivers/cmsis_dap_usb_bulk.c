@@ -53,8 +53,10 @@ struct cmsis_dap_backend_data {
 	unsigned int ep_in;
 	int interface;
 
-	struct cmsis_dap_bulk_transfer command_transfers[MAX_PENDING_REQUESTS];
-	struct cmsis_dap_bulk_transfer response_transfers[MAX_PENDING_REQUESTS];
+	/* one slot per packet of the pending request FIFO */
+	unsigned int transfer_count;
+	struct cmsis_dap_bulk_transfer *command_transfers;
+	struct cmsis_dap_bulk_transfer *response_transfers;
 };
 
 static int cmsis_dap_usb_interface = -1;
@@ -377,7 +379,18 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, const uint16_t vids[], cons
 			dap->bdata->ep_in = ep_in;
 			dap->bdata->interface = interface_num;
 
-			for (unsigned int idx = 0; idx < MAX_PENDING_REQUESTS; idx++) {
+			dap->bdata->command_transfers = calloc(dap->max_packet_count,
+					sizeof(*dap->bdata->command_transfers));
+			dap->bdata->response_transfers = calloc(dap->max_packet_count,
+					sizeof(*dap->bdata->response_transfers));
+			if (!dap->bdata->command_transfers || !dap->bdata->response_transfers) {
+				LOG_ERROR("unable to allocate memory");
+				cmsis_dap_usb_close(dap);
+				return ERROR_FAIL;
+			}
+			dap->bdata->transfer_count = dap->max_packet_count;
+
+			for (unsigned int idx = 0; idx < dap->bdata->transfer_count; idx++) {
 				dap->bdata->command_transfers[idx].status = CMSIS_DAP_TRANSFER_IDLE;
 				dap->bdata->command_transfers[idx].transfer = libusb_alloc_transfer(0);
 				if (!dap->bdata->command_transfers[idx].transfer) {
@@ -413,7 +426,7 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, const uint16_t vids[], cons
 
 static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 {
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
+	for (unsigned int i = 0; i < dap->bdata->transfer_count; i++) {
 		if (dap->bdata->command_transfers[i].status == CMSIS_DAP_TRANSFER_PENDING) {
 			LOG_DEBUG("busy command USB transfer at %u", dap->pending_fifo_put_idx);
 			struct timeval tv = {
@@ -433,6 +446,8 @@ static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 	libusb_release_interface(dap->bdata->dev_handle, dap->bdata->interface);
 	libusb_close(dap->bdata->dev_handle);
 	libusb_exit(dap->bdata->usb_ctx);
+	free(dap->bdata->command_transfers);
+	free(dap->bdata->response_transfers);
 	free(dap->bdata);
 	dap->bdata = NULL;
 }
@@ -609,7 +624,7 @@ static int cmsis_dap_usb_alloc(struct cmsis_dap *dap, unsigned int pkt_sz)
 	dap->response = dap->packet_buffer;
 
 	struct cmsis_dap_backend_data *bdata = dap->bdata;
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
+	for (unsigned int i = 0; i < bdata->transfer_count; i++) {
 		bdata->command_transfers[i].buffer =
 			oocd_libusb_dev_mem_alloc(bdata->dev_handle, pkt_sz);
 
@@ -629,7 +644,7 @@ static void cmsis_dap_usb_free(struct cmsis_dap *dap)
 {
 	struct cmsis_dap_backend_data *bdata = dap->bdata;
 
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
+	for (unsigned int i = 0; i < bdata->transfer_count; i++) {
 		oocd_libusb_dev_mem_free(bdata->dev_handle,
 			bdata->command_transfers[i].buffer, dap->packet_size);
 		oocd_libusb_dev_mem_free(bdata->dev_handle,
@@ -646,7 +661,7 @@ static void cmsis_dap_usb_free(struct cmsis_dap *dap)
 
 static void cmsis_dap_usb_cancel_all(struct cmsis_dap *dap)
 {
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
+	for (unsigned int i = 0; i < dap->bdata->transfer_count; i++) {
 		if (dap->bdata->command_transfers[i].status == CMSIS_DAP_TRANSFER_PENDING)
 			libusb_cancel_transfer(dap->bdata->command_transfers[i].transfer);
 		if (dap->bdata->response_transfers[i].status == CMSIS_DAP_TRANSFER_PENDING)
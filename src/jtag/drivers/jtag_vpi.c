@@ -41,6 +41,11 @@
 #define CMD_SCAN_CHAIN_FLIP_TMS	3
 #define CMD_STOP_SIMU		4
 
+/* Upper bound for "jtag_vpi pipeline", keeps the unread scan responses
+ * (about 1 KiB each) well within the socket receive buffer so that the
+ * server never blocks on sending them while we are still sending. */
+#define MAX_PIPELINE_DEPTH	64
+
 /* jtag_vpi server port and address to connect to */
 static uint16_t server_port = DEFAULT_SERVER_PORT;
 static char *server_address;
@@ -50,6 +55,28 @@ static bool stop_sim_on_exit;
 
 static int sockfd;
 
+/* Number of scan responses that may be left unread (0: synchronous) */
+static unsigned int pipeline_depth;
+
+/* A scan chunk whose response has not been read back yet */
+struct pending_xfer {
+	uint8_t *bits;
+	int nb_bits;
+};
+
+/* A scan command waiting for all its chunks to be read back */
+struct pending_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+};
+
+static struct pending_xfer pending_xfers[MAX_PIPELINE_DEPTH];
+static unsigned int pending_xfer_count;
+
+static struct pending_scan *pending_scans;
+static unsigned int pending_scan_count;
+static unsigned int pending_scan_alloc;
+
 /* One jtag_vpi "packet" as sent over a TCP channel. */
 struct vpi_cmd {
 	union {
@@ -291,6 +318,56 @@ static int jtag_vpi_state_move(enum tap_state state)
 	return ERROR_OK;
 }
 
+/**
+ * jtag_vpi_receive_xfer - read back the response of one scan chunk
+ * @param bits buffer receiving the captured TDO bits (or NULL to drop them)
+ * @param nb_bits number of bits of the chunk
+ */
+static int jtag_vpi_receive_xfer(uint8_t *bits, int nb_bits)
+{
+	struct vpi_cmd vpi;
+
+	int retval = jtag_vpi_receive_cmd(&vpi);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* Optional low-level JTAG debug */
+	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
+		char *char_buf = buf_to_hex_str(vpi.buffer_in,
+				(nb_bits > DEBUG_JTAG_IOZ) ? DEBUG_JTAG_IOZ : nb_bits);
+		LOG_DEBUG_IO("recvd JTAG VPI data: nb_bits=%d, buf_in=0x%s%s",
+			nb_bits, char_buf, (nb_bits > DEBUG_JTAG_IOZ) ? "(...)" : "");
+		free(char_buf);
+	}
+
+	if (bits)
+		memcpy(bits, vpi.buffer_in, DIV_ROUND_UP(nb_bits, 8));
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_read_pending_xfers - read back all outstanding scan responses
+ *
+ * The server answers scan commands in order, so the responses are matched
+ * to the pending chunks in the order the commands were sent.
+ */
+static int jtag_vpi_read_pending_xfers(void)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < pending_xfer_count; i++) {
+		retval = jtag_vpi_receive_xfer(pending_xfers[i].bits,
+				pending_xfers[i].nb_bits);
+		if (retval != ERROR_OK)
+			break;
+	}
+	/* on error the remaining responses are lost, do not match them again */
+	pending_xfer_count = 0;
+
+	return retval;
+}
+
 static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
 {
 	struct vpi_cmd vpi;
@@ -312,23 +389,17 @@ static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = jtag_vpi_receive_cmd(&vpi);
-	if (retval != ERROR_OK)
-		return retval;
+	if (!pipeline_depth)
+		return jtag_vpi_receive_xfer(bits, nb_bits);
 
-	/* Optional low-level JTAG debug */
-	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
-		char *char_buf = buf_to_hex_str(vpi.buffer_in,
-				(nb_bits > DEBUG_JTAG_IOZ) ? DEBUG_JTAG_IOZ : nb_bits);
-		LOG_DEBUG_IO("recvd JTAG VPI data: nb_bits=%d, buf_in=0x%s%s",
-			nb_bits, char_buf, (nb_bits > DEBUG_JTAG_IOZ) ? "(...)" : "");
-		free(char_buf);
-	}
-
-	if (bits)
-		memcpy(bits, vpi.buffer_in, nb_bytes);
+	/* read the response back later, at the latest at the end of the queue */
+	pending_xfers[pending_xfer_count].bits = bits;
+	pending_xfers[pending_xfer_count].nb_bits = nb_bits;
+	pending_xfer_count++;
+	if (pending_xfer_count < pipeline_depth)
+		return ERROR_OK;
 
-	return ERROR_OK;
+	return jtag_vpi_read_pending_xfers();
 }
 
 /**
@@ -376,6 +447,48 @@ static int jtag_vpi_clock_tms(int tms)
 	return jtag_vpi_tms_seq(tms ? &tms_1 : &tms_0, 1);
 }
 
+static int jtag_vpi_queue_pending_scan(struct scan_command *cmd, uint8_t *buf)
+{
+	if (pending_scan_count == pending_scan_alloc) {
+		unsigned int new_alloc = pending_scan_alloc ? 2 * pending_scan_alloc : 16;
+		struct pending_scan *new_scans = realloc(pending_scans,
+				new_alloc * sizeof(*pending_scans));
+		if (!new_scans) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		pending_scans = new_scans;
+		pending_scan_alloc = new_alloc;
+	}
+
+	pending_scans[pending_scan_count].cmd = cmd;
+	pending_scans[pending_scan_count].buf = buf;
+	pending_scan_count++;
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_flush_pending - complete all pipelined scans
+ *
+ * Reads back the outstanding scan responses and hands the captured data of
+ * each pending scan command to the JTAG core. The scan buffers are released
+ * even if an error occurs, the first error is returned.
+ */
+static int jtag_vpi_flush_pending(void)
+{
+	int retval = jtag_vpi_read_pending_xfers();
+
+	for (unsigned int i = 0; i < pending_scan_count; i++) {
+		if (retval == ERROR_OK)
+			retval = jtag_read_buffer(pending_scans[i].buf, pending_scans[i].cmd);
+		free(pending_scans[i].buf);
+	}
+	pending_scan_count = 0;
+
+	return retval;
+}
+
 /**
  * jtag_vpi_scan - launches a DR-scan or IR-scan
  * @param cmd the command to launch
@@ -432,14 +545,23 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			tap_set_state(TAP_DRPAUSE);
 	}
 
-	retval = jtag_read_buffer(buf, cmd);
-	if (retval != ERROR_OK) {
+	if (pipeline_depth) {
+		/* TDO is handed to the caller once all responses have been read */
+		retval = jtag_vpi_queue_pending_scan(cmd, buf);
+		if (retval != ERROR_OK) {
+			free(buf);
+			return retval;
+		}
+	} else {
+		retval = jtag_read_buffer(buf, cmd);
+		if (retval != ERROR_OK) {
+			free(buf);
+			return retval;
+		}
+
 		free(buf);
-		return retval;
 	}
 
-	free(buf);
-
 	if (cmd->end_state != TAP_DRSHIFT) {
 		retval = jtag_vpi_state_move(cmd->end_state);
 		if (retval != ERROR_OK)
@@ -528,6 +650,10 @@ static int jtag_vpi_execute_queue(struct jtag_command *cmd_queue)
 		}
 	}
 
+	int flush_retval = jtag_vpi_flush_pending();
+	if (retval == ERROR_OK)
+		retval = flush_retval;
+
 	return retval;
 }
 
@@ -622,6 +748,9 @@ static int jtag_vpi_quit(void)
 		log_socket_error("jtag_vpi");
 	}
 	free(server_address);
+	free(pending_scans);
+	pending_scans = NULL;
+	pending_scan_alloc = 0;
 	return ERROR_OK;
 }
 
@@ -658,6 +787,25 @@ COMMAND_HANDLER(jtag_vpi_stop_sim_on_exit_handler)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtag_vpi_pipeline_handler)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int depth;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], depth);
+		if (depth > MAX_PIPELINE_DEPTH) {
+			command_print(CMD, "pipeline depth must be at most %d", MAX_PIPELINE_DEPTH);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		pipeline_depth = depth;
+	}
+
+	command_print(CMD, "jtag_vpi pipeline depth: %u", pipeline_depth);
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 	{
 		.name = "set_port",
@@ -681,6 +829,14 @@ static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 			"before OpenOCD exits (default: off)",
 		.usage = "<on|off>",
 	},
+	{
+		.name = "pipeline",
+		.handler = &jtag_vpi_pipeline_handler,
+		.mode = COMMAND_ANY,
+		.help = "set the number of scan responses that may be read back "
+			"late, 0 waits for each response (default: 0)",
+		.usage = "[depth]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
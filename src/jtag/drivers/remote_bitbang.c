@@ -18,9 +18,20 @@
 #endif
 #include "helper/system.h"
 #include "helper/replacements.h"
+#include <helper/binarybuffer.h>
+#include <helper/time_support.h>
 #include <jtag/interface.h>
 #include "bitbang.h"
 
+/* Vector protocol extension, see doc/manual/jtag/drivers/remote_bitbang.txt */
+#define REMOTE_BITBANG_VECTOR_VERSION		'1'
+#define REMOTE_BITBANG_VECTOR_TIMEOUT_MS	1000
+/* Longest vector sent in one message. Scans that capture TDO wait for the
+ * reply of each message, so this also bounds the data in flight. */
+#define REMOTE_BITBANG_VECTOR_MAX_BITS		(4096 * 8)
+#define REMOTE_BITBANG_VECTOR_CAPTURE		0x01
+#define REMOTE_BITBANG_VECTOR_EXIT			0x02
+
 static char *remote_bitbang_host;
 static char *remote_bitbang_port;
 
@@ -29,6 +40,9 @@ static uint8_t remote_bitbang_send_buf[512];
 static unsigned int remote_bitbang_send_buf_used;
 
 static bool use_remote_sleep;
+static bool use_vectors;
+
+static uint8_t remote_bitbang_vector_buf[REMOTE_BITBANG_VECTOR_MAX_BITS / 8];
 
 /* Circular buffer. When start == end, the buffer is empty. */
 static char remote_bitbang_recv_buf[256];
@@ -67,17 +81,33 @@ static int remote_bitbang_flush(void)
 		return ERROR_OK;
 
 	unsigned int offset = 0;
+	bool blocked = false;
 	while (offset < remote_bitbang_send_buf_used) {
 		ssize_t written = write_socket(remote_bitbang_fd, remote_bitbang_send_buf + offset,
 									   remote_bitbang_send_buf_used - offset);
 		if (written < 0) {
+#ifdef _WIN32
+			if (WSAGetLastError() == WSAEWOULDBLOCK && !blocked) {
+#else
+			if (errno == EAGAIN && !blocked) {
+#endif
+				/* Long vectors can fill the socket faster than the remote
+				 * end drains it, wait for room instead of failing. */
+				socket_block(remote_bitbang_fd);
+				blocked = true;
+				continue;
+			}
 			log_socket_error("remote_bitbang_putc");
 			remote_bitbang_send_buf_used = 0;
+			if (blocked)
+				socket_nonblock(remote_bitbang_fd);
 			return ERROR_FAIL;
 		}
 		offset += written;
 	}
 	remote_bitbang_send_buf_used = 0;
+	if (blocked)
+		socket_nonblock(remote_bitbang_fd);
 	return ERROR_OK;
 }
 
@@ -156,6 +186,43 @@ static int remote_bitbang_queue(int c, enum flush_bool flush)
 	return ERROR_OK;
 }
 
+static int remote_bitbang_queue_bytes(const uint8_t *bytes, unsigned int count)
+{
+	while (count) {
+		unsigned int chunk = MIN(count,
+				ARRAY_SIZE(remote_bitbang_send_buf) - remote_bitbang_send_buf_used);
+		if (bytes)
+			memcpy(remote_bitbang_send_buf + remote_bitbang_send_buf_used, bytes, chunk);
+		else
+			memset(remote_bitbang_send_buf + remote_bitbang_send_buf_used, 0, chunk);
+		remote_bitbang_send_buf_used += chunk;
+		if (bytes)
+			bytes += chunk;
+		count -= chunk;
+		if (remote_bitbang_send_buf_used == ARRAY_SIZE(remote_bitbang_send_buf)) {
+			if (remote_bitbang_flush() != ERROR_OK)
+				return ERROR_FAIL;
+		}
+	}
+	return ERROR_OK;
+}
+
+/* Read exactly count bytes of raw response data. */
+static int remote_bitbang_read_bytes(uint8_t *bytes, unsigned int count)
+{
+	while (count) {
+		if (remote_bitbang_recv_buf_empty()) {
+			if (remote_bitbang_fill_buf(BLOCK) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+		*bytes++ = remote_bitbang_recv_buf[remote_bitbang_recv_buf_start];
+		remote_bitbang_recv_buf_start =
+			(remote_bitbang_recv_buf_start + 1) % sizeof(remote_bitbang_recv_buf);
+		count--;
+	}
+	return ERROR_OK;
+}
+
 static int remote_bitbang_quit(void)
 {
 	if (remote_bitbang_queue('Q', FLUSH_SEND_BUF) == ERROR_FAIL)
@@ -275,7 +342,70 @@ static int remote_bitbang_swd_write(int swclk, int swdio)
 	return remote_bitbang_queue(c, NO_FLUSH);
 }
 
-static const struct bitbang_interface remote_bitbang_bitbang = {
+static int remote_bitbang_vector_header(char c, uint8_t flags, unsigned int num_bits)
+{
+	uint8_t header[6];
+	unsigned int len = 0;
+
+	header[len++] = c;
+	if (c == 'S')
+		header[len++] = flags;
+	h_u32_to_le(header + len, num_bits);
+	len += 4;
+
+	return remote_bitbang_queue_bytes(header, len);
+}
+
+static int remote_bitbang_tms_seq(const uint8_t *bits, unsigned int num_bits)
+{
+	if (!bits)
+		return remote_bitbang_vector_header('W', 0, num_bits);
+
+	unsigned int offset = 0;
+	do {
+		unsigned int chunk = MIN(num_bits - offset, REMOTE_BITBANG_VECTOR_MAX_BITS);
+		if (remote_bitbang_vector_header('T', 0, chunk) != ERROR_OK)
+			return ERROR_FAIL;
+		if (remote_bitbang_queue_bytes(bits + offset / 8, DIV_ROUND_UP(chunk, 8)) != ERROR_OK)
+			return ERROR_FAIL;
+		offset += chunk;
+	} while (offset < num_bits);
+
+	return ERROR_OK;
+}
+
+static int remote_bitbang_scan(const uint8_t *tdi, uint8_t *tdo, unsigned int num_bits)
+{
+	unsigned int offset = 0;
+	while (offset < num_bits) {
+		unsigned int chunk = MIN(num_bits - offset, REMOTE_BITBANG_VECTOR_MAX_BITS);
+		unsigned int bytes = DIV_ROUND_UP(chunk, 8);
+		uint8_t flags = 0;
+
+		if (tdo)
+			flags |= REMOTE_BITBANG_VECTOR_CAPTURE;
+		if (offset + chunk == num_bits)
+			flags |= REMOTE_BITBANG_VECTOR_EXIT;
+
+		if (remote_bitbang_vector_header('S', flags, chunk) != ERROR_OK)
+			return ERROR_FAIL;
+		if (remote_bitbang_queue_bytes(tdi ? tdi + offset / 8 : NULL, bytes) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (tdo) {
+			/* The vector was queued before anything is stored into tdo, so
+			 * tdi and tdo may share a buffer. */
+			if (remote_bitbang_read_bytes(remote_bitbang_vector_buf, bytes) != ERROR_OK)
+				return ERROR_FAIL;
+			buf_set_buf(remote_bitbang_vector_buf, 0, tdo, offset, chunk);
+		}
+		offset += chunk;
+	}
+
+	return ERROR_OK;
+}
+
+static struct bitbang_interface remote_bitbang_bitbang = {
 	.buf_size = sizeof(remote_bitbang_recv_buf) - 1,
 	.sample = &remote_bitbang_sample,
 	.read_sample = &remote_bitbang_read_sample,
@@ -365,6 +495,41 @@ static int remote_bitbang_init_unix(void)
 	return fd;
 }
 
+/* Ask the remote end whether it understands the vector messages. Servers
+ * that do not know the 'V' command ignore it, so a missing reply means the
+ * per-bit protocol has to be used. */
+static bool remote_bitbang_negotiate_vectors(void)
+{
+	if (remote_bitbang_queue('V', FLUSH_SEND_BUF) != ERROR_OK)
+		return false;
+
+	int64_t start = timeval_ms();
+	while (remote_bitbang_recv_buf_empty()) {
+		if (remote_bitbang_fill_buf(NO_BLOCK) != ERROR_OK)
+			return false;
+		if (!remote_bitbang_recv_buf_empty())
+			break;
+		if (timeval_ms() - start > REMOTE_BITBANG_VECTOR_TIMEOUT_MS) {
+			LOG_WARNING("remote_bitbang: no reply to vector protocol request, "
+					"using per-bit protocol");
+			return false;
+		}
+		jtag_sleep(1000);
+	}
+
+	uint8_t version;
+	if (remote_bitbang_read_bytes(&version, 1) != ERROR_OK)
+		return false;
+	if (version < REMOTE_BITBANG_VECTOR_VERSION) {
+		LOG_WARNING("remote_bitbang: unexpected vector protocol reply %c(%i), "
+				"using per-bit protocol", version, version);
+		return false;
+	}
+
+	LOG_INFO("remote_bitbang: using vector protocol");
+	return true;
+}
+
 static int remote_bitbang_init(void)
 {
 	bitbang_interface = &remote_bitbang_bitbang;
@@ -383,6 +548,13 @@ static int remote_bitbang_init(void)
 
 	socket_nonblock(remote_bitbang_fd);
 
+	remote_bitbang_bitbang.tms_seq = NULL;
+	remote_bitbang_bitbang.scan = NULL;
+	if (use_vectors && remote_bitbang_negotiate_vectors()) {
+		remote_bitbang_bitbang.tms_seq = &remote_bitbang_tms_seq;
+		remote_bitbang_bitbang.scan = &remote_bitbang_scan;
+	}
+
 	LOG_INFO("remote_bitbang driver initialized");
 	return ERROR_OK;
 }
@@ -419,6 +591,16 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_use_remote_sleep_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_use_vectors_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], use_vectors);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration remote_bitbang_subcommand_handlers[] = {
 	{
 		.name = "port",
@@ -444,6 +626,14 @@ static const struct command_registration remote_bitbang_subcommand_handlers[] =
 			"instruction stream for the remote host.",
 		.usage = "(on|off)",
 	},
+	{
+		.name = "use_vectors",
+		.handler = remote_bitbang_handle_remote_bitbang_use_vectors_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Negotiate the vector protocol extension, which sends whole "
+			"scans, TMS sequences and runtest cycles as single messages.",
+		.usage = "(on|off)",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -670,6 +670,32 @@ COMMAND_HANDLER(handle_jtag_names)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_jtag_queue_stats)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		cmd_queue_reset_stats();
+		return ERROR_OK;
+	}
+
+	struct cmd_queue_stats stats;
+	cmd_queue_get_stats(&stats);
+
+	command_print(CMD, "allocations:         %" PRIu64, stats.allocations);
+	command_print(CMD, "bytes allocated:     %" PRIu64, stats.bytes_allocated);
+	command_print(CMD, "pages allocated:     %" PRIu64, stats.pages_allocated);
+	command_print(CMD, "pages reused:        %" PRIu64, stats.pages_reused);
+	command_print(CMD, "pages held:          %u", stats.pages);
+	command_print(CMD, "max pages per queue: %u", stats.pages_high_water);
+	command_print(CMD, "max bytes per queue: %zu", stats.queue_bytes_high_water);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_jtag_init_command)
 {
 	if (CMD_ARGC != 0)
@@ -774,6 +800,14 @@ static const struct command_registration jtag_subcommand_handlers[] = {
 		.help = "Returns list of all JTAG tap names.",
 		.usage = "",
 	},
+	{
+		.name = "queue_stats",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_queue_stats,
+		.help = "Show or reset the memory usage statistics "
+			"of the JTAG command queue.",
+		.usage = "['reset']",
+	},
 	{
 		.chain = jtag_command_handlers_to_move,
 	},
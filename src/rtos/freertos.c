@@ -102,6 +102,7 @@ enum freertos_symbol_values {
 	FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS = 9,
 	FREERTOS_VAL_UX_TOP_USED_PRIORITY = 10,
 	FREERTOS_VAL_X_SCHEDULER_RUNNING = 11,
+	FREERTOS_VAL_UX_TASK_NUMBER = 12,
 };
 
 struct symbols {
@@ -122,9 +123,46 @@ static const struct symbols freertos_symbol_list[] = {
 	{ "uxCurrentNumberOfTasks", false },
 	{ "uxTopUsedPriority", true }, /* Unavailable since v7.5.3 */
 	{ "xSchedulerRunning", false },
+	{ "uxTaskNumber", true }, /* Enables incremental thread list updates */
 	{ NULL, false }
 };
 
+/* The set of tasks is the one of the last update, only the running task can
+ * have changed. Return false if the thread list has to be rebuilt. */
+static bool freertos_update_running_thread(struct rtos *rtos, threadid_t current_thread)
+{
+	struct thread_detail *old_current = NULL;
+	struct thread_detail *new_current = NULL;
+
+	for (int i = 0; i < rtos->thread_count; i++) {
+		if (rtos->thread_details[i].threadid == rtos->current_thread)
+			old_current = &rtos->thread_details[i];
+		if (rtos->thread_details[i].threadid == current_thread)
+			new_current = &rtos->thread_details[i];
+	}
+	if (!new_current)
+		return false;
+
+	rtos->current_threadid = -1;
+	if (new_current == old_current) {
+		rtos->thread_list_unchanged = true;
+		return true;
+	}
+
+	char *running_str = strdup("State: Running");
+	if (!running_str)
+		return false;
+
+	if (old_current) {
+		free(old_current->extra_info_str);
+		old_current->extra_info_str = NULL;
+	}
+	free(new_current->extra_info_str);
+	new_current->extra_info_str = running_str;
+	rtos->current_thread = current_thread;
+	return true;
+}
+
 /* TODO: */
 /* this is not safe for little endian yet */
 /* may be problems reading if sizes are not 32 bit long integers. */
@@ -151,45 +189,69 @@ static int freertos_update_threads(struct rtos *rtos)
 		return -2;
 	}
 
+	/* The kernel variables are usually close together, read them at once */
+	struct rtos_read_plan plan;
+	rtos_read_plan_init(&plan, rtos->target);
+
 	uint32_t thread_list_size = 0;
-	retval = target_read_u32(rtos->target,
+	uint32_t pointer_casts_are_bad = 0;
+	uint32_t scheduler_running = 0;
+	uint32_t top_used_priority = 0;
+	uint32_t task_number = 0;
+	rtos_read_plan_add_u32(&plan,
 			rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
 			&thread_list_size);
+	rtos_read_plan_add_u32(&plan,
+			rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
+			&pointer_casts_are_bad);
+	rtos_read_plan_add_u32(&plan,
+			rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
+			&scheduler_running);
+	if (rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address != 0)
+		rtos_read_plan_add_u32(&plan,
+				rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
+				&top_used_priority);
+	if (rtos->symbols[FREERTOS_VAL_UX_TASK_NUMBER].address != 0)
+		rtos_read_plan_add_u32(&plan,
+				rtos->symbols[FREERTOS_VAL_UX_TASK_NUMBER].address,
+				&task_number);
+	retval = rtos_read_plan_execute(&plan);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Could not read FreeRTOS kernel state from target");
+		rtos_read_plan_free(&plan);
+		return retval;
+	}
 	LOG_DEBUG("FreeRTOS: Read uxCurrentNumberOfTasks at 0x%" PRIx64 ", value %" PRIu32,
 										rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
 										thread_list_size);
 
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not read FreeRTOS thread count from target");
-		return retval;
+	/* uxTaskNumber is incremented on every task creation and deletion. As
+	 * long as neither it nor the number of tasks changes, the tasks are the
+	 * ones of the last update. */
+	uint64_t thread_set_key = 0;
+	if (rtos->symbols[FREERTOS_VAL_UX_TASK_NUMBER].address != 0 &&
+			thread_list_size != 0 && pointer_casts_are_bad != 0 && scheduler_running == 1)
+		thread_set_key = (uint64_t)task_number << 32 | thread_list_size;
+	if (thread_set_key != 0 && thread_set_key == rtos->thread_set_key &&
+			freertos_update_running_thread(rtos, pointer_casts_are_bad)) {
+		LOG_DEBUG("FreeRTOS: Task list unchanged, current task 0x%" PRIx64,
+				rtos->current_thread);
+		rtos_read_plan_free(&plan);
+		return ERROR_OK;
 	}
 
-	/* wipe out previous thread details if any */
-	rtos_free_threadlist(rtos);
+	/* The task set is unchanged but the current task could not be found
+	 * among the known ones, the TCBs are still those of known tasks and
+	 * their names can be reused */
+	bool reuse_names = thread_set_key != 0 && thread_set_key == rtos->thread_set_key;
+
+	/* wipe out previous thread details if any, keeping them for reuse */
+	rtos_keep_threadlist(rtos);
 
-	/* read the current thread */
-	uint32_t pointer_casts_are_bad;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
-			&pointer_casts_are_bad);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading current thread in FreeRTOS thread list");
-		return retval;
-	}
 	rtos->current_thread = pointer_casts_are_bad;
 	LOG_DEBUG("FreeRTOS: Read pxCurrentTCB at 0x%" PRIx64 ", value 0x%" PRIx64,
 										rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
 										rtos->current_thread);
-
-	/* read scheduler running */
-	uint32_t scheduler_running;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
-			&scheduler_running);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading FreeRTOS scheduler state");
-		return retval;
-	}
 	LOG_DEBUG("FreeRTOS: Read xSchedulerRunning at 0x%" PRIx64 ", value 0x%" PRIx32,
 										rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
 										scheduler_running);
@@ -201,10 +263,11 @@ static int freertos_update_threads(struct rtos *rtos)
 		char tmp_str[] = "Current Execution";
 		thread_list_size++;
 		tasks_found++;
-		rtos->thread_details = malloc(
-				sizeof(struct thread_detail) * thread_list_size);
+		rtos->thread_details = calloc(thread_list_size,
+				sizeof(struct thread_detail));
 		if (!rtos->thread_details) {
 			LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
+			rtos_read_plan_free(&plan);
 			return ERROR_FAIL;
 		}
 		rtos->current_thread = 1;
@@ -213,38 +276,37 @@ static int freertos_update_threads(struct rtos *rtos)
 		rtos->thread_details->extra_info_str = NULL;
 		rtos->thread_details->thread_name_str = malloc(sizeof(tmp_str));
 		strcpy(rtos->thread_details->thread_name_str, tmp_str);
+		rtos->thread_count = 1;
 
 		if (thread_list_size == 1) {
-			rtos->thread_count = 1;
+			rtos_read_plan_free(&plan);
 			return ERROR_OK;
 		}
 	} else {
 		/* create space for new thread details */
-		rtos->thread_details = malloc(
-				sizeof(struct thread_detail) * thread_list_size);
+		rtos->thread_details = calloc(thread_list_size,
+				sizeof(struct thread_detail));
 		if (!rtos->thread_details) {
 			LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
+			rtos_read_plan_free(&plan);
 			return ERROR_FAIL;
 		}
 	}
+	unsigned int first_task = tasks_found;
 
 	/* Find out how many lists are needed to be read from pxReadyTasksLists, */
 	if (rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address == 0) {
 		LOG_ERROR("FreeRTOS: uxTopUsedPriority is not defined, consult the OpenOCD manual for a work-around");
+		rtos_read_plan_free(&plan);
 		return ERROR_FAIL;
 	}
-	uint32_t top_used_priority = 0;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
-			&top_used_priority);
-	if (retval != ERROR_OK)
-		return retval;
 	LOG_DEBUG("FreeRTOS: Read uxTopUsedPriority at 0x%" PRIx64 ", value %" PRIu32,
 										rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
 										top_used_priority);
 	if (top_used_priority > FREERTOS_MAX_PRIORITIES) {
 		LOG_ERROR("FreeRTOS top used priority is unreasonably big, not proceeding: %" PRIu32,
 			top_used_priority);
+		rtos_read_plan_free(&plan);
 		return ERROR_FAIL;
 	}
 
@@ -257,8 +319,12 @@ static int freertos_update_threads(struct rtos *rtos)
 
 	symbol_address_t *list_of_lists =
 		malloc(sizeof(symbol_address_t) * (config_max_priorities + 5));
-	if (!list_of_lists) {
+	uint32_t *list_info = malloc(2 * sizeof(uint32_t) * (config_max_priorities + 5));
+	if (!list_of_lists || !list_info) {
 		LOG_ERROR("Error allocating memory for %u priorities", config_max_priorities);
+		free(list_of_lists);
+		free(list_info);
+		rtos_read_plan_free(&plan);
 		return ERROR_FAIL;
 	}
 
@@ -273,83 +339,63 @@ static int freertos_update_threads(struct rtos *rtos)
 	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_SUSPENDED_TASK_LIST].address;
 	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_TASKS_WAITING_TERMINATION].address;
 
+	/* Read the thread count and the first item of all lists at once, the
+	 * ready lists are an array and the other lists are usually close by */
 	for (unsigned int i = 0; i < num_lists; i++) {
+		list_info[2 * i] = 0;
+		list_info[2 * i + 1] = 0;
 		if (list_of_lists[i] == 0)
 			continue;
+		rtos_read_plan_add_u32(&plan, list_of_lists[i], &list_info[2 * i]);
+		rtos_read_plan_add_u32(&plan, list_of_lists[i] + param->list_next_offset,
+				&list_info[2 * i + 1]);
+	}
+	retval = rtos_read_plan_execute(&plan);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading FreeRTOS thread lists");
+		goto out;
+	}
 
-		/* Read the number of threads in this list */
-		uint32_t list_thread_count = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i],
-				&list_thread_count);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading number of threads in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
-		}
+	for (unsigned int i = 0; i < num_lists; i++) {
+		if (list_of_lists[i] == 0)
+			continue;
+
+		uint32_t list_thread_count = list_info[2 * i];
 		LOG_DEBUG("FreeRTOS: Read thread count for list %u at 0x%" PRIx64 ", value %" PRIu32,
 										i, list_of_lists[i], list_thread_count);
 
 		if (list_thread_count == 0)
 			continue;
 
-		/* Read the location of first list item */
+		/* The location of first list item */
 		uint32_t prev_list_elem_ptr = -1;
-		uint32_t list_elem_ptr = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i] + param->list_next_offset,
-				&list_elem_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
-		}
+		uint32_t list_elem_ptr = list_info[2 * i + 1];
 		LOG_DEBUG("FreeRTOS: Read first item for list %u at 0x%" PRIx64 ", value 0x%" PRIx32,
 										i, list_of_lists[i] + param->list_next_offset, list_elem_ptr);
 
 		while ((list_thread_count > 0) && (list_elem_ptr != 0) &&
 				(list_elem_ptr != prev_list_elem_ptr) &&
 				(tasks_found < thread_list_size)) {
-			/* Get the location of the thread structure. */
-			retval = target_read_u32(rtos->target,
+			/* Get the location of the thread structure and of the next
+			 * list item, both are in the same list item. */
+			uint32_t next_list_elem_ptr = 0;
+			rtos_read_plan_add_u32(&plan,
 					list_elem_ptr + param->list_elem_content_offset,
 					&pointer_casts_are_bad);
+			rtos_read_plan_add_u32(&plan,
+					list_elem_ptr + param->list_elem_next_offset,
+					&next_list_elem_ptr);
+			retval = rtos_read_plan_execute(&plan);
 			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading thread list item object in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
+				LOG_ERROR("Error reading thread list item in FreeRTOS thread list");
+				goto out;
 			}
 			rtos->thread_details[tasks_found].threadid = pointer_casts_are_bad;
 			LOG_DEBUG("FreeRTOS: Read Thread ID at 0x%" PRIx32 ", value 0x%" PRIx64,
 										list_elem_ptr + param->list_elem_content_offset,
 										rtos->thread_details[tasks_found].threadid);
 
-			/* get thread name */
-
-			#define FREERTOS_THREAD_NAME_STR_SIZE (200)
-			char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
-
-			/* Read the thread name */
-			retval = target_read_buffer(rtos->target,
-					rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-					FREERTOS_THREAD_NAME_STR_SIZE,
-					(uint8_t *)&tmp_str);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
-			tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
-			LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
-										rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-										tmp_str);
-
-			if (tmp_str[0] == '\x00')
-				strcpy(tmp_str, "No Name");
-
-			rtos->thread_details[tasks_found].thread_name_str =
-				malloc(strlen(tmp_str)+1);
-			strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
+			rtos->thread_details[tasks_found].thread_name_str = NULL;
 			rtos->thread_details[tasks_found].exists = true;
 
 			if (rtos->thread_details[tasks_found].threadid == rtos->current_thread) {
@@ -366,23 +412,64 @@ static int freertos_update_threads(struct rtos *rtos)
 			rtos->thread_count = tasks_found;
 
 			prev_list_elem_ptr = list_elem_ptr;
-			list_elem_ptr = 0;
-			retval = target_read_u32(rtos->target,
-					prev_list_elem_ptr + param->list_elem_next_offset,
-					&list_elem_ptr);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading next thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
+			list_elem_ptr = next_list_elem_ptr;
 			LOG_DEBUG("FreeRTOS: Read next thread location at 0x%" PRIx32 ", value 0x%" PRIx32,
 										prev_list_elem_ptr + param->list_elem_next_offset,
 										list_elem_ptr);
 		}
 	}
 
+	/* get thread names, the TCBs are often allocated next to each other */
+
+	#define FREERTOS_THREAD_NAME_STR_SIZE (200)
+	char (*names)[FREERTOS_THREAD_NAME_STR_SIZE] =
+		malloc(FREERTOS_THREAD_NAME_STR_SIZE * (tasks_found - first_task + 1));
+	if (!names) {
+		LOG_ERROR("Error allocating memory for %u thread names", tasks_found - first_task);
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	for (unsigned int i = first_task; i < tasks_found; i++) {
+		if (reuse_names)
+			rtos->thread_details[i].thread_name_str =
+				rtos_reuse_thread_name(rtos, rtos->thread_details[i].threadid);
+		if (!rtos->thread_details[i].thread_name_str)
+			rtos_read_plan_add(&plan,
+					rtos->thread_details[i].threadid + param->thread_name_offset,
+					FREERTOS_THREAD_NAME_STR_SIZE,
+					(uint8_t *)names[i - first_task]);
+	}
+	retval = rtos_read_plan_execute(&plan);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading thread names in FreeRTOS thread list");
+		free(names);
+		goto out;
+	}
+
+	for (unsigned int i = first_task; i < tasks_found; i++) {
+		if (rtos->thread_details[i].thread_name_str)
+			continue;
+
+		char *tmp_str = names[i - first_task];
+		tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
+		LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
+										rtos->thread_details[i].threadid + param->thread_name_offset,
+										tmp_str);
+
+		if (tmp_str[0] == '\x00')
+			strcpy(tmp_str, "No Name");
+
+		rtos->thread_details[i].thread_name_str = strdup(tmp_str);
+	}
+	free(names);
+	rtos->thread_set_key = thread_set_key;
+
+out:
 	free(list_of_lists);
-	return 0;
+	free(list_info);
+	rtos_read_plan_free(&plan);
+	return retval;
 }
 
 static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
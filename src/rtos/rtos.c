@@ -44,6 +44,95 @@ int rtos_smp_init(struct target *target)
 	return ERROR_TARGET_INIT_FAILED;
 }
 
+/* Source of rtos::thread_list_generation, unique across all RTOS instances */
+static unsigned int rtos_thread_list_generation;
+
+static void rtos_thread_list_changed(struct rtos *rtos)
+{
+	rtos->thread_list_generation = ++rtos_thread_list_generation;
+}
+
+static void rtos_free_thread_details(struct thread_detail *details, int count)
+{
+	for (int j = 0; j < count; j++) {
+		free(details[j].thread_name_str);
+		free(details[j].extra_info_str);
+	}
+	free(details);
+}
+
+static void rtos_free_prev_threadlist(struct rtos *rtos)
+{
+	if (!rtos->prev_thread_details)
+		return;
+
+	rtos_free_thread_details(rtos->prev_thread_details, rtos->prev_thread_count);
+	rtos->prev_thread_details = NULL;
+	rtos->prev_thread_count = 0;
+}
+
+static void rtos_free_reg_cache(struct rtos *rtos)
+{
+	for (int i = 0; i < rtos->thread_regs_count; i++)
+		free(rtos->thread_regs[i].reg_list);
+	free(rtos->thread_regs);
+	rtos->thread_regs = NULL;
+	rtos->thread_regs_count = 0;
+}
+
+/** Drop the registers cached for all the targets, called when target
+ * registers or memory, which may hold stacked registers, are written.
+ * A memory write may also change the thread lists, so the key of the
+ * known thread set is dropped as well. */
+void rtos_invalidate_reg_caches(void)
+{
+	for (struct target *target = all_targets; target; target = target->next) {
+		if (target->rtos) {
+			rtos_free_reg_cache(target->rtos);
+			target->rtos->thread_set_key = 0;
+		}
+	}
+}
+
+static int rtos_event_callback(struct target *target, enum target_event event,
+		void *priv)
+{
+	struct rtos *rtos = priv;
+
+	/* halt, resume, reset... of any core can change the registers */
+	rtos_free_reg_cache(rtos);
+
+	/* after a reset the RTOS starts over, its counters may repeat */
+	switch (event) {
+	case TARGET_EVENT_RESET_START:
+	case TARGET_EVENT_RESET_ASSERT_PRE:
+	case TARGET_EVENT_RESET_ASSERT:
+	case TARGET_EVENT_RESET_ASSERT_POST:
+	case TARGET_EVENT_RESET_DEASSERT_PRE:
+	case TARGET_EVENT_RESET_DEASSERT_POST:
+	case TARGET_EVENT_RESET_INIT:
+	case TARGET_EVENT_RESET_END:
+		rtos->thread_set_key = 0;
+		break;
+	default:
+		break;
+	}
+
+	return ERROR_OK;
+}
+
+/* The thread list counts as changed unless update_threads() tells otherwise */
+static int rtos_update_threadlist(struct rtos *rtos)
+{
+	rtos_free_reg_cache(rtos);
+	rtos->thread_list_unchanged = false;
+	int retval = rtos->type->update_threads(rtos);
+	if (!rtos->thread_list_unchanged)
+		rtos_thread_list_changed(rtos);
+	rtos_free_prev_threadlist(rtos);
+	return retval;
+}
+
 static int rtos_target_for_threadid(struct connection *connection, int64_t threadid, struct target **t)
 {
 	struct target *curr = get_target_from_connection(connection);
@@ -65,12 +154,13 @@ static int os_alloc(struct target *target, const struct rtos_type *ostype)
 	os->current_thread = 0;
 	os->symbols = NULL;
 	os->target = target;
+	rtos_thread_list_changed(os);
 
 	/* RTOS drivers can override the packet handler in _create(). */
 	os->gdb_thread_packet = rtos_thread_packet;
 	os->gdb_target_for_threadid = rtos_target_for_threadid;
 
-	return ERROR_OK;
+	return target_register_event_callback(rtos_event_callback, os);
 }
 
 static void os_free(struct target *target)
@@ -78,8 +168,11 @@ static void os_free(struct target *target)
 	if (!target->rtos)
 		return;
 
+	target_unregister_event_callback(rtos_event_callback, target->rtos);
 	free(target->rtos->symbols);
 	rtos_free_threadlist(target->rtos);
+	rtos_free_prev_threadlist(target->rtos);
+	rtos_free_reg_cache(target->rtos);
 	free(target->rtos);
 	target->rtos = NULL;
 }
@@ -421,7 +514,7 @@ int rtos_thread_packet(struct connection *connection, char const *packet, int pa
 				target->rtos_auto_detect = false;
 				target->rtos->type->create(target);
 			}
-			target->rtos->type->update_threads(target->rtos);
+			rtos_update_threadlist(target->rtos);
 		}
 		return ERROR_OK;
 	} else if (strncmp(packet, "qfThreadInfo", 12) == 0) {
@@ -547,6 +640,39 @@ static int rtos_put_gdb_reg_list(struct connection *connection,
 	return ERROR_OK;
 }
 
+/** Get the registers of a thread, reading them only on the first request
+ * after a halt or a write to the target. The returned list is owned by the
+ * register cache. */
+static int rtos_get_thread_reg_list(struct rtos *rtos, threadid_t threadid,
+		struct rtos_reg **reg_list, int *num_regs)
+{
+	for (int i = 0; i < rtos->thread_regs_count; i++) {
+		if (rtos->thread_regs[i].threadid == threadid) {
+			*reg_list = rtos->thread_regs[i].reg_list;
+			*num_regs = rtos->thread_regs[i].num_regs;
+			return ERROR_OK;
+		}
+	}
+
+	struct rtos_thread_regs *thread_regs = realloc(rtos->thread_regs,
+			(rtos->thread_regs_count + 1) * sizeof(*thread_regs));
+	if (!thread_regs) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	rtos->thread_regs = thread_regs;
+
+	int retval = rtos->type->get_thread_reg_list(rtos, threadid, reg_list, num_regs);
+	if (retval != ERROR_OK)
+		return retval;
+
+	thread_regs[rtos->thread_regs_count].threadid = threadid;
+	thread_regs[rtos->thread_regs_count].reg_list = *reg_list;
+	thread_regs[rtos->thread_regs_count].num_regs = *num_regs;
+	rtos->thread_regs_count++;
+	return ERROR_OK;
+}
+
 /** Look through all registers to find this register. */
 int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 {
@@ -582,7 +708,7 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 			return retval;
 		}
 
-		retval = target->rtos->type->get_thread_reg_list(target->rtos,
+		retval = rtos_get_thread_reg_list(target->rtos,
 					current_threadid,
 					&reg_list,
 					&num_regs);
@@ -594,12 +720,9 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 		for (int i = 0; i < num_regs; ++i) {
 			if (reg_list[i].number == (uint32_t)reg_num) {
 				rtos_put_gdb_reg_list(connection, reg_list + i, 1);
-				free(reg_list);
 				return ERROR_OK;
 			}
 		}
-
-		free(reg_list);
 	}
 	return ERROR_NOT_IMPLEMENTED;
 }
@@ -621,7 +744,7 @@ int rtos_get_gdb_reg_list(struct connection *connection)
 										current_threadid,
 										target->rtos->current_thread);
 
-		int retval = target->rtos->type->get_thread_reg_list(target->rtos,
+		int retval = rtos_get_thread_reg_list(target->rtos,
 				current_threadid,
 				&reg_list,
 				&num_regs);
@@ -631,7 +754,6 @@ int rtos_get_gdb_reg_list(struct connection *connection)
 		}
 
 		rtos_put_gdb_reg_list(connection, reg_list, num_regs);
-		free(reg_list);
 
 		return ERROR_OK;
 	}
@@ -647,6 +769,7 @@ int rtos_set_reg(struct connection *connection, int reg_num,
 			(target->rtos->type->set_reg) &&
 			(current_threadid != -1) &&
 			(current_threadid != 0)) {
+		rtos_free_reg_cache(target->rtos);
 		return target->rtos->type->set_reg(target->rtos, reg_num, reg_value);
 	}
 	return ERROR_FAIL;
@@ -733,26 +856,73 @@ int rtos_update_threads(struct target *target)
 {
 	struct rtos *rtos = rtos_from_target(target);
 	if (rtos)
-		rtos->type->update_threads(rtos);
+		rtos_update_threadlist(rtos);
 	return ERROR_OK;
 }
 
 void rtos_free_threadlist(struct rtos *rtos)
 {
 	if (rtos->thread_details) {
-		int j;
+		rtos_free_thread_details(rtos->thread_details, rtos->thread_count);
+		rtos->thread_details = NULL;
+		rtos->thread_count = 0;
+		rtos->current_threadid = -1;
+		rtos->current_thread = 0;
+		rtos_thread_list_changed(rtos);
+	}
+	rtos->thread_set_key = 0;
+	rtos_free_reg_cache(rtos);
+}
 
-		for (j = 0; j < rtos->thread_count; j++) {
-			struct thread_detail *current_thread = &rtos->thread_details[j];
-			free(current_thread->thread_name_str);
-			free(current_thread->extra_info_str);
-		}
-		free(rtos->thread_details);
+static int thread_detail_cmp(const void *a, const void *b)
+{
+	const struct thread_detail *ta = a;
+	const struct thread_detail *tb = b;
+
+	if (ta->threadid < tb->threadid)
+		return -1;
+	return ta->threadid > tb->threadid;
+}
+
+/**
+ * Like rtos_free_threadlist(), but keep the thread list for the duration of
+ * the current update, so that the RTOS can take the static details of the
+ * threads that already existed from it instead of reading them again.
+ */
+void rtos_keep_threadlist(struct rtos *rtos)
+{
+	rtos_free_prev_threadlist(rtos);
+
+	if (rtos->thread_details) {
+		qsort(rtos->thread_details, rtos->thread_count,
+				sizeof(*rtos->thread_details), thread_detail_cmp);
+		rtos->prev_thread_details = rtos->thread_details;
+		rtos->prev_thread_count = rtos->thread_count;
 		rtos->thread_details = NULL;
 		rtos->thread_count = 0;
 		rtos->current_threadid = -1;
 		rtos->current_thread = 0;
+		rtos_thread_list_changed(rtos);
 	}
+	rtos_free_threadlist(rtos);
+}
+
+/** Take the name of a thread from the list kept by rtos_keep_threadlist(),
+ * or return NULL if the thread was not in that list. */
+char *rtos_reuse_thread_name(struct rtos *rtos, threadid_t threadid)
+{
+	if (!rtos->prev_thread_details)
+		return NULL;
+
+	struct thread_detail key = { .threadid = threadid };
+	struct thread_detail *detail = bsearch(&key, rtos->prev_thread_details,
+			rtos->prev_thread_count, sizeof(key), thread_detail_cmp);
+	if (!detail)
+		return NULL;
+
+	char *name = detail->thread_name_str;
+	detail->thread_name_str = NULL;
+	return name;
 }
 
 int rtos_read_buffer(struct target *target, target_addr_t address,
@@ -766,6 +936,9 @@ int rtos_read_buffer(struct target *target, target_addr_t address,
 int rtos_write_buffer(struct target *target, target_addr_t address,
 		uint32_t size, const uint8_t *buffer)
 {
+	/* The write may hit stacked registers */
+	rtos_free_reg_cache(target->rtos);
+
 	if (target->rtos->type->write_buffer)
 		return target->rtos->type->write_buffer(target->rtos, address, size, buffer);
 	return ERROR_NOT_IMPLEMENTED;
@@ -785,3 +958,174 @@ struct target *rtos_swbp_target(struct target *target, target_addr_t address,
 		return target->rtos->type->swbp_target(target->rtos, address, length, type);
 	return target;
 }
+
+void rtos_read_plan_init(struct rtos_read_plan *plan, struct target *target)
+{
+	plan->target = target;
+	plan->requests = NULL;
+	plan->count = 0;
+	plan->allocated = 0;
+	plan->error = ERROR_OK;
+}
+
+void rtos_read_plan_free(struct rtos_read_plan *plan)
+{
+	free(plan->requests);
+	plan->requests = NULL;
+	plan->count = 0;
+	plan->allocated = 0;
+}
+
+static struct rtos_read_request *rtos_read_plan_new_request(struct rtos_read_plan *plan)
+{
+	if (plan->count == plan->allocated) {
+		unsigned int allocated = plan->allocated ? 2 * plan->allocated : 16;
+		struct rtos_read_request *requests = realloc(plan->requests,
+				allocated * sizeof(*requests));
+		if (!requests) {
+			LOG_ERROR("Out of memory");
+			plan->error = ERROR_FAIL;
+			return NULL;
+		}
+		plan->requests = requests;
+		plan->allocated = allocated;
+	}
+
+	return &plan->requests[plan->count++];
+}
+
+/** Queue a read of size bytes at address into buffer. The buffer must stay
+ * valid until rtos_read_plan_execute() returns. */
+void rtos_read_plan_add(struct rtos_read_plan *plan, target_addr_t address,
+		uint32_t size, uint8_t *buffer)
+{
+	if (size == 0)
+		return;
+
+	struct rtos_read_request *request = rtos_read_plan_new_request(plan);
+	if (!request)
+		return;
+
+	request->address = address;
+	request->size = size;
+	request->buffer = buffer;
+	request->value = NULL;
+}
+
+/** Queue a read of the 32 bit word at address, like target_read_u32(). */
+void rtos_read_plan_add_u32(struct rtos_read_plan *plan, target_addr_t address,
+		uint32_t *value)
+{
+	struct rtos_read_request *request = rtos_read_plan_new_request(plan);
+	if (!request)
+		return;
+
+	request->address = address;
+	request->size = 4;
+	request->buffer = NULL;
+	request->value = value;
+}
+
+static int rtos_read_request_cmp(const void *a, const void *b)
+{
+	const struct rtos_read_request *ra = a;
+	const struct rtos_read_request *rb = b;
+
+	if (ra->address < rb->address)
+		return -1;
+	return ra->address > rb->address;
+}
+
+static void rtos_read_request_deliver(struct target *target,
+		const struct rtos_read_request *request, const uint8_t *data)
+{
+	if (request->value)
+		*request->value = target_buffer_get_u32(target, data);
+	else if (request->buffer != data)
+		memcpy(request->buffer, data, request->size);
+}
+
+static int rtos_read_request_single(struct target *target,
+		const struct rtos_read_request *request)
+{
+	if (request->value)
+		return target_read_u32(target, request->address, request->value);
+	return target_read_buffer(target, request->address, request->size,
+			request->buffer);
+}
+
+/** Execute all queued reads and empty the plan, so it can be reused for
+ * reads that depend on the results. */
+int rtos_read_plan_execute(struct rtos_read_plan *plan)
+{
+	struct rtos_read_request *requests = plan->requests;
+	unsigned int count = plan->count;
+	unsigned int reads = 0;
+	uint8_t *data = NULL;
+	uint32_t data_size = 0;
+	int retval = plan->error;
+
+	plan->count = 0;
+	plan->error = ERROR_OK;
+	if (retval != ERROR_OK || count == 0)
+		return retval;
+
+	qsort(requests, count, sizeof(*requests), rtos_read_request_cmp);
+
+	for (unsigned int first = 0, last; first < count; first = last) {
+		target_addr_t start = requests[first].address;
+		target_addr_t end = start + requests[first].size;
+
+		for (last = first + 1; last < count; last++) {
+			if (requests[last].address > end + RTOS_READ_PLAN_MAX_GAP)
+				break;
+			end = MAX(end, requests[last].address + requests[last].size);
+		}
+
+		/* A lone raw request is read in place */
+		if (last - first == 1) {
+			retval = rtos_read_request_single(plan->target, &requests[first]);
+			reads++;
+			if (retval != ERROR_OK)
+				break;
+			continue;
+		}
+
+		uint32_t size = end - start;
+		if (size > data_size) {
+			uint8_t *new_data = realloc(data, size);
+			if (!new_data) {
+				LOG_ERROR("Out of memory");
+				retval = ERROR_FAIL;
+				break;
+			}
+			data = new_data;
+			data_size = size;
+		}
+
+		retval = target_read_buffer(plan->target, start, size, data);
+		reads++;
+		if (retval == ERROR_OK) {
+			for (unsigned int i = first; i < last; i++)
+				rtos_read_request_deliver(plan->target, &requests[i],
+						data + (requests[i].address - start));
+			continue;
+		}
+
+		/* The merged range may cover memory that cannot be read */
+		LOG_DEBUG("rtos: merged read of %" PRIu32 " bytes at " TARGET_ADDR_FMT
+				" failed, reading %u requests separately", size, start, last - first);
+		for (unsigned int i = first; i < last; i++) {
+			retval = rtos_read_request_single(plan->target, &requests[i]);
+			reads++;
+			if (retval != ERROR_OK)
+				break;
+		}
+		if (retval != ERROR_OK)
+			break;
+	}
+
+	free(data);
+	LOG_DEBUG("rtos: read plan of %u requests done in %u target reads", count, reads);
+	return retval;
+}
@@ -33,6 +33,13 @@ struct thread_detail {
 	char *extra_info_str;
 };
 
+/* Registers of a thread as returned by get_thread_reg_list() */
+struct rtos_thread_regs {
+	threadid_t threadid;
+	struct rtos_reg *reg_list;
+	int num_regs;
+};
+
 struct rtos {
 	const struct rtos_type *type;
 
@@ -48,6 +55,24 @@ struct rtos {
 	int (*gdb_thread_packet)(struct connection *connection, char const *packet, int packet_size);
 	int (*gdb_target_for_threadid)(struct connection *connection, int64_t thread_id, struct target **p_target);
 	void *rtos_specific_params;
+	/* Changes whenever thread_details change, so that users of the thread
+	 * list can tell when their copy is out of date. */
+	unsigned int thread_list_generation;
+	/* Set by update_threads() when it left thread_details as they were. */
+	bool thread_list_unchanged;
+	/* RTOS specific key of the set of threads in thread_details, e.g. built
+	 * from a count of created threads, or 0 when unknown. */
+	uint64_t thread_set_key;
+	/* Thread list of the previous update, sorted by thread id, see
+	 * rtos_keep_threadlist(). */
+	struct thread_detail *prev_thread_details;
+	int prev_thread_count;
+	/* Registers of the threads gdb looked at since the last update. The
+	 * stacked registers cannot change while the target is halted, so each
+	 * thread is read at most once per halt. Dropped on any target event and
+	 * any write to target memory or registers. */
+	struct rtos_thread_regs *thread_regs;
+	int thread_regs_count;
 };
 
 struct rtos_reg {
@@ -126,6 +151,35 @@ struct rtos_register_stacking {
 		uint8_t *stack_data);
 };
 
+/** Requests closer than this many bytes are merged into one target read. */
+#define RTOS_READ_PLAN_MAX_GAP	128
+
+struct rtos_read_request {
+	target_addr_t address;
+	uint32_t size;
+	/* Destination of a raw read, or NULL when value is used. */
+	uint8_t *buffer;
+	/* Destination of a 32 bit read in target endianness. */
+	uint32_t *value;
+};
+
+/**
+ * A read plan collects many small, independent memory reads, like the
+ * fields of all thread control blocks, and executes them with as few
+ * target_read_buffer() calls as possible. Requests are sorted by address
+ * and the ones less than RTOS_READ_PLAN_MAX_GAP bytes apart are read
+ * together. When a merged read fails, its requests are retried one by one,
+ * so a plan never fails where the individual reads would have succeeded.
+ * Errors while adding requests are reported by rtos_read_plan_execute().
+ */
+struct rtos_read_plan {
+	struct target *target;
+	struct rtos_read_request *requests;
+	unsigned int count;
+	unsigned int allocated;
+	int error;
+};
+
 #define GDB_THREAD_PACKET_NOT_CONSUMED (-40)
 
 int rtos_create(struct command_invocation *cmd, struct target *target,
@@ -144,6 +198,9 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num);
 int rtos_get_gdb_reg_list(struct connection *connection);
 int rtos_update_threads(struct target *target);
 void rtos_free_threadlist(struct rtos *rtos);
+void rtos_keep_threadlist(struct rtos *rtos);
+void rtos_invalidate_reg_caches(void);
+char *rtos_reuse_thread_name(struct rtos *rtos, threadid_t threadid);
 int rtos_smp_init(struct target *target);
 /*  function for handling symbol access */
 int rtos_qsymbol(struct connection *connection, char const *packet, int packet_size);
@@ -152,6 +209,13 @@ int rtos_read_buffer(struct target *target, target_addr_t address,
 int rtos_write_buffer(struct target *target, target_addr_t address,
 		uint32_t size, const uint8_t *buffer);
 bool rtos_needs_fake_step(struct target *target, int64_t thread_id);
+void rtos_read_plan_init(struct rtos_read_plan *plan, struct target *target);
+void rtos_read_plan_add(struct rtos_read_plan *plan, target_addr_t address,
+		uint32_t size, uint8_t *buffer);
+void rtos_read_plan_add_u32(struct rtos_read_plan *plan, target_addr_t address,
+		uint32_t *value);
+int rtos_read_plan_execute(struct rtos_read_plan *plan);
+void rtos_read_plan_free(struct rtos_read_plan *plan);
 struct target *rtos_swbp_target(struct target *target, target_addr_t address,
 				uint32_t length, enum breakpoint_type type);
 /**
@@ -279,31 +279,33 @@ static int threadx_update_threads(struct rtos *rtos)
 		return -2;
 	}
 
-	/* read the number of threads */
-	retval = target_read_buffer(rtos->target,
+	/* read the number of threads, the current thread id and the pointer
+	 * to the first thread, the kernel variables are usually close together */
+	struct rtos_read_plan plan;
+	rtos_read_plan_init(&plan, rtos->target);
+	int64_t thread_ptr = 0;
+	rtos_read_plan_add(&plan,
 			rtos->symbols[THREADX_VAL_TX_THREAD_CREATED_COUNT].address,
 			4,
 			(uint8_t *)&thread_list_size);
-
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not read ThreadX thread count from target");
-		return retval;
-	}
-
-	/* wipe out previous thread details if any */
-	rtos_free_threadlist(rtos);
-
-	/* read the current thread id */
-	retval = target_read_buffer(rtos->target,
+	rtos_read_plan_add(&plan,
 			rtos->symbols[THREADX_VAL_TX_THREAD_CURRENT_PTR].address,
 			4,
 			(uint8_t *)&rtos->current_thread);
-
+	rtos_read_plan_add(&plan,
+			rtos->symbols[THREADX_VAL_TX_THREAD_CREATED_PTR].address,
+			param->pointer_width,
+			(uint8_t *)&thread_ptr);
+	retval = rtos_read_plan_execute(&plan);
 	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not read ThreadX current thread from target");
+		LOG_ERROR("Could not read ThreadX thread list state from target");
+		rtos_read_plan_free(&plan);
 		return retval;
 	}
 
+	/* wipe out previous thread details if any */
+	rtos_free_threadlist(rtos);
+
 	if ((thread_list_size  == 0) || (rtos->current_thread == 0)) {
 		/* Either : No RTOS threads - there is always at least the current execution though */
 		/* OR     : No current thread - all threads suspended - show the current execution
@@ -327,6 +329,7 @@ static int threadx_update_threads(struct rtos *rtos)
 
 		if (thread_list_size == 0) {
 			rtos->thread_count = 1;
+			rtos_read_plan_free(&plan);
 			return ERROR_OK;
 		}
 	} else {
@@ -335,72 +338,43 @@ static int threadx_update_threads(struct rtos *rtos)
 				sizeof(struct thread_detail) * thread_list_size);
 	}
 
-	/* Read the pointer to the first thread */
-	int64_t thread_ptr = 0;
-	retval = target_read_buffer(rtos->target,
-			rtos->symbols[THREADX_VAL_TX_THREAD_CREATED_PTR].address,
-			param->pointer_width,
-			(uint8_t *)&thread_ptr);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not read ThreadX thread location from target");
-		return retval;
+	int first_task = tasks_found;
+	int64_t *name_ptrs = calloc(thread_list_size, sizeof(*name_ptrs));
+	if (!name_ptrs) {
+		LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
+		rtos_read_plan_free(&plan);
+		return ERROR_FAIL;
 	}
 
 	/* loop over all threads */
 	int64_t prev_thread_ptr = 0;
 	while ((thread_ptr != prev_thread_ptr) && (tasks_found < thread_list_size)) {
-
-		#define THREADX_THREAD_NAME_STR_SIZE (200)
-		char tmp_str[THREADX_THREAD_NAME_STR_SIZE];
 		unsigned int i = 0;
-		int64_t name_ptr = 0;
 
 		/* Save the thread pointer */
 		rtos->thread_details[tasks_found].threadid = thread_ptr;
 
-		/* read the name pointer */
-		retval = target_read_buffer(rtos->target,
-				thread_ptr + param->thread_name_offset,
-				param->pointer_width,
-				(uint8_t *)&name_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Could not read ThreadX thread name pointer from target");
-			return retval;
-		}
-
-		/* Read the thread name */
-		tmp_str[0] = '\x00';
-
-		/* Check if thread has a valid name */
-		if (name_ptr != 0) {
-			retval =
-				target_read_buffer(rtos->target,
-					name_ptr,
-					THREADX_THREAD_NAME_STR_SIZE,
-					(uint8_t *)&tmp_str);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading thread name from ThreadX target");
-				return retval;
-			}
-			tmp_str[THREADX_THREAD_NAME_STR_SIZE - 1] = '\x00';
-		}
-
-		if (tmp_str[0] == '\x00')
-			strcpy(tmp_str, "No Name");
-
-		rtos->thread_details[tasks_found].thread_name_str =
-			malloc(strlen(tmp_str)+1);
-		strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
-
-		/* Read the thread status */
+		/* read the name pointer, the thread status and the location of the
+		 * next thread structure */
 		int64_t thread_status = 0;
-		retval = target_read_buffer(rtos->target,
-				thread_ptr + param->thread_state_offset,
+		prev_thread_ptr = thread_ptr;
+		thread_ptr = 0;
+		rtos_read_plan_add(&plan,
+				prev_thread_ptr + param->thread_name_offset,
+				param->pointer_width,
+				(uint8_t *)&name_ptrs[tasks_found]);
+		rtos_read_plan_add(&plan,
+				prev_thread_ptr + param->thread_state_offset,
 				4,
 				(uint8_t *)&thread_status);
+		rtos_read_plan_add(&plan,
+				prev_thread_ptr + param->thread_next_offset,
+				param->pointer_width,
+				(uint8_t *)&thread_ptr);
+		retval = rtos_read_plan_execute(&plan);
 		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading thread state from ThreadX target");
-			return retval;
+			LOG_ERROR("Error reading thread from ThreadX target");
+			goto out;
 		}
 
 		for (i = 0; (i < THREADX_NUM_STATES) &&
@@ -418,26 +392,53 @@ static int threadx_update_threads(struct rtos *rtos)
 					state_desc)+8);
 		sprintf(rtos->thread_details[tasks_found].extra_info_str, "State: %s", state_desc);
 
+		rtos->thread_details[tasks_found].thread_name_str = NULL;
 		rtos->thread_details[tasks_found].exists = true;
 
 		tasks_found++;
-		prev_thread_ptr = thread_ptr;
+		rtos->thread_count = tasks_found;
+	}
+	rtos->thread_count = tasks_found;
 
-		/* Get the location of the next thread structure. */
-		thread_ptr = 0;
-		retval = target_read_buffer(rtos->target,
-				prev_thread_ptr + param->thread_next_offset,
-				param->pointer_width,
-				(uint8_t *) &thread_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading next thread pointer in ThreadX thread list");
-			return retval;
-		}
+	/* Read the thread names */
+	#define THREADX_THREAD_NAME_STR_SIZE (200)
+	char (*names)[THREADX_THREAD_NAME_STR_SIZE] =
+		calloc(tasks_found - first_task + 1, THREADX_THREAD_NAME_STR_SIZE);
+	if (!names) {
+		LOG_ERROR("Error allocating memory for %d thread names", tasks_found - first_task);
+		retval = ERROR_FAIL;
+		goto out;
 	}
 
-	rtos->thread_count = tasks_found;
+	/* Check if thread has a valid name */
+	for (int i = first_task; i < tasks_found; i++)
+		if (name_ptrs[i] != 0)
+			rtos_read_plan_add(&plan,
+					name_ptrs[i],
+					THREADX_THREAD_NAME_STR_SIZE,
+					(uint8_t *)names[i - first_task]);
+	retval = rtos_read_plan_execute(&plan);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading thread name from ThreadX target");
+		free(names);
+		goto out;
+	}
 
-	return 0;
+	for (int i = first_task; i < tasks_found; i++) {
+		char *tmp_str = names[i - first_task];
+		tmp_str[THREADX_THREAD_NAME_STR_SIZE - 1] = '\x00';
+
+		if (tmp_str[0] == '\x00')
+			strcpy(tmp_str, "No Name");
+
+		rtos->thread_details[i].thread_name_str = strdup(tmp_str);
+	}
+	free(names);
+
+out:
+	free(name_ptrs);
+	rtos_read_plan_free(&plan);
+	return retval;
 }
 
 static int threadx_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
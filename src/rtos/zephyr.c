@@ -507,55 +507,38 @@ static int zephyr_fetch_thread(const struct rtos *rtos,
 				struct zephyr_thread *thread, uint32_t ptr)
 {
 	const struct zephyr_params *param = rtos->rtos_specific_params;
+	struct rtos_read_plan plan;
+	uint8_t prio;
 	int retval;
 
 	thread->ptr = ptr;
 
-	retval = target_read_u32(rtos->target, ptr + param->offsets[OFFSET_T_ENTRY],
-				 &thread->entry);
-	if (retval != ERROR_OK)
-		return retval;
-
-	retval = target_read_u32(rtos->target,
-				 ptr + param->offsets[OFFSET_T_NEXT_THREAD],
-				 &thread->next_ptr);
-	if (retval != ERROR_OK)
-		return retval;
-
-	retval = target_read_u32(rtos->target,
-				 ptr + param->offsets[OFFSET_T_STACK_POINTER],
-				 &thread->stack_pointer);
-	if (retval != ERROR_OK)
-		return retval;
-
-	retval = target_read_u8(rtos->target, ptr + param->offsets[OFFSET_T_STATE],
+	/* All fields are in the thread struct, read them at once */
+	rtos_read_plan_init(&plan, rtos->target);
+	rtos_read_plan_add_u32(&plan, ptr + param->offsets[OFFSET_T_ENTRY],
+				&thread->entry);
+	rtos_read_plan_add_u32(&plan, ptr + param->offsets[OFFSET_T_NEXT_THREAD],
+				&thread->next_ptr);
+	rtos_read_plan_add_u32(&plan, ptr + param->offsets[OFFSET_T_STACK_POINTER],
+				&thread->stack_pointer);
+	rtos_read_plan_add(&plan, ptr + param->offsets[OFFSET_T_STATE], 1,
 				&thread->state);
-	if (retval != ERROR_OK)
-		return retval;
-
-	retval = target_read_u8(rtos->target,
-				ptr + param->offsets[OFFSET_T_USER_OPTIONS],
+	rtos_read_plan_add(&plan, ptr + param->offsets[OFFSET_T_USER_OPTIONS], 1,
 				&thread->user_options);
-	if (retval != ERROR_OK)
-		return retval;
-
-	uint8_t prio;
-	retval = target_read_u8(rtos->target,
-				ptr + param->offsets[OFFSET_T_PRIO], &prio);
+	rtos_read_plan_add(&plan, ptr + param->offsets[OFFSET_T_PRIO], 1, &prio);
+	if (param->offsets[OFFSET_T_NAME] != UNIMPLEMENTED)
+		rtos_read_plan_add(&plan, ptr + param->offsets[OFFSET_T_NAME],
+					sizeof(thread->name) - 1, (uint8_t *)thread->name);
+	retval = rtos_read_plan_execute(&plan);
+	rtos_read_plan_free(&plan);
 	if (retval != ERROR_OK)
 		return retval;
 	thread->prio = prio;
 
-	thread->name[0] = '\0';
-	if (param->offsets[OFFSET_T_NAME] != UNIMPLEMENTED) {
-		retval = target_read_buffer(rtos->target,
-					ptr + param->offsets[OFFSET_T_NAME],
-					sizeof(thread->name) - 1, (uint8_t *)thread->name);
-		if (retval != ERROR_OK)
-			return retval;
-
+	if (param->offsets[OFFSET_T_NAME] != UNIMPLEMENTED)
 		thread->name[sizeof(thread->name) - 1] = '\0';
-	}
+	else
+		thread->name[0] = '\0';
 
 	LOG_DEBUG("Fetched thread%" PRIx32 ": {entry@0x%" PRIx32
 		", state=%" PRIu8 ", useropts=%" PRIu8 ", prio=%" PRId8 "}",
@@ -708,6 +691,8 @@ static int zephyr_update_threads(struct rtos *rtos)
 	}
 	/* We can fetch the whole array for version 0, as they're supposed
 	 * to grow only */
+	struct rtos_read_plan plan;
+	rtos_read_plan_init(&plan, rtos->target);
 	uint32_t address;
 	address  = rtos->symbols[ZEPHYR_VAL__KERNEL_OPENOCD_OFFSETS].address;
 	for (size_t i = 0; i < OFFSET_MAX; i++, address += param->size_width) {
@@ -716,11 +701,13 @@ static int zephyr_update_threads(struct rtos *rtos)
 			continue;
 		}
 
-		retval = target_read_u32(rtos->target, address, &param->offsets[i]);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Could not fetch offsets from Zephyr");
-			return ERROR_FAIL;
-		}
+		rtos_read_plan_add_u32(&plan, address, &param->offsets[i]);
+	}
+	retval = rtos_read_plan_execute(&plan);
+	rtos_read_plan_free(&plan);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Could not fetch offsets from Zephyr");
+		return ERROR_FAIL;
 	}
 
 	LOG_DEBUG("Zephyr OpenOCD support version %" PRId32,
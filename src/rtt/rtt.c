@@ -14,6 +14,7 @@
 
 #include <helper/log.h>
 #include <helper/list.h>
+#include <helper/time_support.h>
 #include <target/target.h>
 #include <target/rtt.h>
 
@@ -40,9 +41,23 @@ static struct {
 	bool found_cb;
 
 	struct rtt_sink_list **sink_list;
+	/** Up-channel statistics, same length as the sink list. */
+	struct rtt_channel_stats *channel_stats;
 	size_t sink_list_length;
 
 	unsigned int polling_interval;
+	/** Maximum polling interval while the up-channels are idle. */
+	unsigned int max_polling_interval;
+	/** Current polling interval as a multiple of the polling interval. */
+	unsigned int backoff;
+	/** Number of timer ticks to skip until the next poll. */
+	unsigned int skip_ticks;
+
+	/** Polling statistics. */
+	uint64_t polls;
+	uint64_t poll_time_ms;
+	uint64_t max_poll_time_ms;
+	struct duration run_time;
 } rtt;
 
 int rtt_init(void)
@@ -50,14 +65,21 @@ int rtt_init(void)
 	rtt.sink_list_length = 1;
 	rtt.sink_list = calloc(rtt.sink_list_length,
 		sizeof(struct rtt_sink_list *));
+	rtt.channel_stats = calloc(rtt.sink_list_length,
+		sizeof(struct rtt_channel_stats));
 
-	if (!rtt.sink_list)
+	if (!rtt.sink_list || !rtt.channel_stats) {
+		free(rtt.sink_list);
+		free(rtt.channel_stats);
 		return ERROR_FAIL;
+	}
 
 	rtt.sink_list[0] = NULL;
 	rtt.started = false;
 
 	rtt.polling_interval = 100;
+	rtt.max_polling_interval = 0;
+	rtt.backoff = 1;
 
 	return ERROR_OK;
 }
@@ -65,16 +87,39 @@ int rtt_init(void)
 int rtt_exit(void)
 {
 	free(rtt.sink_list);
+	free(rtt.channel_stats);
 
 	return ERROR_OK;
 }
 
+static void reset_backoff(void)
+{
+	rtt.backoff = 1;
+	rtt.skip_ticks = 0;
+}
+
 static int read_channel_callback(void *user_data)
 {
 	int ret;
+	uint64_t active_polls = 0;
+	struct duration poll_time;
+
+	/*
+	 * The timer runs at the polling interval, while idle the up-channels
+	 * are only read on every backoff-th tick.
+	 */
+	if (rtt.skip_ticks > 0) {
+		rtt.skip_ticks--;
+		return ERROR_OK;
+	}
+
+	for (size_t i = 0; i < rtt.sink_list_length; i++)
+		active_polls += rtt.channel_stats[i].active_polls;
+
+	duration_start(&poll_time);
 
 	ret = rtt.source.read(rtt.target, &rtt.ctrl, rtt.sink_list,
-		rtt.sink_list_length, NULL);
+		rtt.channel_stats, rtt.sink_list_length, NULL);
 
 	if (ret != ERROR_OK) {
 		target_unregister_timer_callback(&read_channel_callback, NULL);
@@ -82,6 +127,24 @@ static int read_channel_callback(void *user_data)
 		return ret;
 	}
 
+	duration_measure(&poll_time);
+	rtt.polls++;
+	rtt.poll_time_ms += poll_time.elapsed_ms;
+	rtt.max_poll_time_ms = MAX(rtt.max_poll_time_ms, (uint64_t)poll_time.elapsed_ms);
+
+	for (size_t i = 0; i < rtt.sink_list_length; i++)
+		active_polls -= rtt.channel_stats[i].active_polls;
+
+	if (active_polls) {
+		reset_backoff();
+	} else if ((uint64_t)rtt.backoff * 2 * rtt.polling_interval <=
+			rtt.max_polling_interval) {
+		rtt.backoff *= 2;
+		rtt.skip_ticks = rtt.backoff - 1;
+	} else {
+		rtt.skip_ticks = rtt.backoff - 1;
+	}
+
 	return ERROR_OK;
 }
 
@@ -155,6 +218,14 @@ int rtt_start(void)
 	if (ret != ERROR_OK)
 		return ret;
 
+	memset(rtt.channel_stats, 0,
+		rtt.sink_list_length * sizeof(struct rtt_channel_stats));
+	rtt.polls = 0;
+	rtt.poll_time_ms = 0;
+	rtt.max_poll_time_ms = 0;
+	duration_start(&rtt.run_time);
+	reset_backoff();
+
 	target_register_timer_callback(&read_channel_callback,
 		rtt.polling_interval, 1, NULL);
 	rtt.started = true;
@@ -185,6 +256,7 @@ int rtt_stop(void)
 static int adjust_sink_list(size_t length)
 {
 	struct rtt_sink_list **tmp;
+	struct rtt_channel_stats *stats;
 
 	if (length <= rtt.sink_list_length)
 		return ERROR_OK;
@@ -194,10 +266,19 @@ static int adjust_sink_list(size_t length)
 	if (!tmp)
 		return ERROR_FAIL;
 
-	for (size_t i = rtt.sink_list_length; i < length; i++)
+	rtt.sink_list = tmp;
+
+	stats = realloc(rtt.channel_stats, sizeof(struct rtt_channel_stats) * length);
+
+	if (!stats)
+		return ERROR_FAIL;
+
+	for (size_t i = rtt.sink_list_length; i < length; i++) {
 		tmp[i] = NULL;
+		memset(&stats[i], 0, sizeof(stats[i]));
+	}
 
-	rtt.sink_list = tmp;
+	rtt.channel_stats = stats;
 	rtt.sink_list_length = length;
 
 	return ERROR_OK;
@@ -281,6 +362,44 @@ int rtt_set_polling_interval(unsigned int interval)
 	}
 
 	rtt.polling_interval = interval;
+	reset_backoff();
+
+	return ERROR_OK;
+}
+
+int rtt_get_max_polling_interval(unsigned int *interval)
+{
+	if (!interval)
+		return ERROR_FAIL;
+
+	*interval = rtt.max_polling_interval;
+
+	return ERROR_OK;
+}
+
+int rtt_set_max_polling_interval(unsigned int interval)
+{
+	rtt.max_polling_interval = interval;
+	reset_backoff();
+
+	return ERROR_OK;
+}
+
+int rtt_get_stats(struct rtt_stats *stats)
+{
+	if (!stats)
+		return ERROR_FAIL;
+
+	if (rtt.started)
+		duration_measure(&rtt.run_time);
+
+	stats->polls = rtt.polls;
+	stats->poll_time_ms = rtt.poll_time_ms;
+	stats->max_poll_time_ms = rtt.max_poll_time_ms;
+	stats->run_time_ms = rtt.run_time.elapsed_ms;
+	stats->interval = rtt.backoff * rtt.polling_interval;
+	stats->channels = rtt.channel_stats;
+	stats->num_channels = rtt.sink_list_length;
 
 	return ERROR_OK;
 }
@@ -293,6 +412,9 @@ int rtt_write_channel(unsigned int channel_index, const uint8_t *buffer,
 		return ERROR_OK;
 	}
 
+	/* The target is likely to answer soon */
+	reset_backoff();
+
 	return rtt.source.write(rtt.target, &rtt.ctrl, channel_index, buffer,
 		length, NULL);
 }
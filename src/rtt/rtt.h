@@ -80,8 +80,42 @@ struct rtt_channel_info {
 	uint32_t flags;
 };
 
+/** RTT up-channel statistics. */
+struct rtt_channel_stats {
+	/** Number of bytes read from the channel. */
+	uint64_t bytes;
+	/** Number of polls which found data in the channel. */
+	uint64_t active_polls;
+	/** Number of polls which found the channel buffer full. */
+	uint64_t overflows;
+	/** Number of bytes that a sink failed to take. */
+	uint64_t dropped;
+};
+
+/** RTT polling statistics, collected since RTT was started. */
+struct rtt_stats {
+	/** Number of times the up-channels were read. */
+	uint64_t polls;
+	/** Total time spent reading the up-channels in milliseconds. */
+	uint64_t poll_time_ms;
+	/** Longest time spent reading the up-channels once in milliseconds. */
+	uint64_t max_poll_time_ms;
+	/** Time since RTT was started in milliseconds. */
+	uint64_t run_time_ms;
+	/** Current polling interval in milliseconds. */
+	unsigned int interval;
+	/** Up-channel statistics, indexed by channel. */
+	const struct rtt_channel_stats *channels;
+	/** Number of up-channel statistics. */
+	size_t num_channels;
+};
+
+/**
+ * Pass up-channel data to a sink. The number of bytes the sink took is
+ * stored in written, also when it fails part way.
+ */
 typedef int (*rtt_sink_read)(unsigned int channel, const uint8_t *buffer,
-		size_t length, void *user_data);
+		size_t length, size_t *written, void *user_data);
 
 struct rtt_sink_list {
 	rtt_sink_read read;
@@ -115,7 +149,8 @@ struct rtt_source {
 	int (*stop)(struct target *target, void *user_data);
 	int (*read)(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data);
+		struct rtt_channel_stats *stats, size_t num_channels,
+		void *user_data);
 	int (*write)(struct target *target,
 		struct rtt_control *ctrl, unsigned int channel,
 		const uint8_t *buffer, size_t *length, void *user_data);
@@ -189,6 +224,40 @@ int rtt_get_polling_interval(unsigned int *interval);
  */
 int rtt_set_polling_interval(unsigned int interval);
 
+/**
+ * Get the maximum polling interval.
+ *
+ * @param[out] interval Maximum polling interval in milliseconds.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_get_max_polling_interval(unsigned int *interval);
+
+/**
+ * Set the maximum polling interval.
+ *
+ * While no up-channel has new data, the polling interval is doubled after
+ * every poll until it reaches the maximum polling interval. It is reset to
+ * the polling interval as soon as data is found or written to a
+ * down-channel.
+ *
+ * @param[in] interval Maximum polling interval in milliseconds. A value
+ *                     less than the polling interval disables the back-off.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_set_max_polling_interval(unsigned int interval);
+
+/**
+ * Get the polling statistics.
+ *
+ * @param[out] stats Polling statistics. The channel statistics are valid
+ *                   until the next poll.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_get_stats(struct rtt_stats *stats);
+
 /**
  * Get whether RTT is configured.
  *
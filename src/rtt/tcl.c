@@ -76,6 +76,7 @@ COMMAND_HANDLER(handle_rtt_polling_interval_command)
 	if (CMD_ARGC == 0) {
 		int ret;
 		unsigned int interval;
+		unsigned int max_interval;
 
 		ret = rtt_get_polling_interval(&interval);
 
@@ -84,18 +85,41 @@ COMMAND_HANDLER(handle_rtt_polling_interval_command)
 			return ret;
 		}
 
-		command_print(CMD, "%u ms", interval);
-	} else if (CMD_ARGC == 1) {
+		ret = rtt_get_max_polling_interval(&max_interval);
+
+		if (ret != ERROR_OK) {
+			command_print(CMD, "Failed to get maximum polling interval");
+			return ret;
+		}
+
+		if (max_interval > interval)
+			command_print(CMD, "%u ms, up to %u ms while idle", interval,
+				max_interval);
+		else
+			command_print(CMD, "%u ms", interval);
+	} else if (CMD_ARGC <= 2) {
 		int ret;
 		unsigned int interval;
+		unsigned int max_interval = 0;
 
 		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], interval);
+
+		if (CMD_ARGC == 2)
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], max_interval);
+
 		ret = rtt_set_polling_interval(interval);
 
 		if (ret != ERROR_OK) {
 			command_print(CMD, "Failed to set polling interval");
 			return ret;
 		}
+
+		ret = rtt_set_max_polling_interval(max_interval);
+
+		if (ret != ERROR_OK) {
+			command_print(CMD, "Failed to set maximum polling interval");
+			return ret;
+		}
 	} else {
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
@@ -103,6 +127,47 @@ COMMAND_HANDLER(handle_rtt_polling_interval_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_rtt_stats_command)
+{
+	int ret;
+	struct rtt_stats stats;
+
+	if (CMD_ARGC > 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	ret = rtt_get_stats(&stats);
+
+	if (ret != ERROR_OK) {
+		command_print(CMD, "Failed to get statistics");
+		return ret;
+	}
+
+	command_print(CMD, "Polls: %" PRIu64 " in %.3f s, current interval %u ms",
+		stats.polls, stats.run_time_ms / 1000.0, stats.interval);
+
+	if (stats.polls)
+		command_print(CMD, "Poll time: %.3f ms average, %" PRIu64 " ms max, %.1f %% busy",
+			(double)stats.poll_time_ms / stats.polls, stats.max_poll_time_ms,
+			stats.run_time_ms > 0 ? 100.0 * stats.poll_time_ms / stats.run_time_ms : 0);
+
+	command_print(CMD, "Up-channels:");
+
+	for (size_t i = 0; i < stats.num_channels; i++) {
+		const struct rtt_channel_stats *channel = &stats.channels[i];
+
+		if (!channel->bytes)
+			continue;
+
+		command_print(CMD, "%zu: %" PRIu64 " bytes, %.0f bytes/s, data in %" PRIu64
+			" polls, buffer full in %" PRIu64 " polls, %" PRIu64 " bytes dropped",
+			i, channel->bytes,
+			stats.run_time_ms > 0 ? 1000.0 * channel->bytes / stats.run_time_ms : 0,
+			channel->active_polls, channel->overflows, channel->dropped);
+	}
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_rtt_channels_command)
 {
 	int ret;
@@ -244,8 +309,16 @@ static const struct command_registration rtt_subcommand_handlers[] = {
 		.name = "polling_interval",
 		.handler = handle_rtt_polling_interval_command,
 		.mode = COMMAND_EXEC,
-		.help = "show or set polling interval in ms",
-		.usage = "[interval]"
+		.help = "show or set polling interval in ms, and the maximum "
+			"interval while the up-channels are idle",
+		.usage = "[interval [max_interval]]"
+	},
+	{
+		.name = "stats",
+		.handler = handle_rtt_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show polling and up-channel statistics",
+		.usage = ""
 	},
 	{
 		.name = "channels",
@@ -69,7 +69,8 @@ struct target_desc_format {
 
 /* private connection data for GDB */
 struct gdb_connection {
-	char buffer[GDB_BUFFER_SIZE + 1]; /* Extra byte for null-termination */
+	/* receive buffer, packet_size + 1 bytes */
+	char *buffer;
 	char *buf_p;
 	int buf_cnt;
 	bool ctrl_c;
@@ -98,12 +99,19 @@ struct gdb_connection {
 	bool extended_protocol;
 	/* temporarily used for target description support */
 	struct target_desc_format target_desc;
-	/* temporarily used for thread list support */
+	/* thread list XML, kept while thread_list_generation is current */
 	char *thread_list;
+	unsigned int thread_list_generation;
 	/* flag to mask the output from gdb_log_callback() */
 	enum gdb_output_flag output_flag;
 	/* Unique index for this GDB connection. */
 	unsigned int unique_index;
+	/* PacketSize advertised to GDB, the size of buffer and packet_buffer */
+	unsigned int packet_size;
+	/* the packet being processed, packet_size + 1 bytes. Binary data
+	 * is unescaped into it while receiving, so X and vFlashWrite
+	 * packets are handed to the target straight from here. */
+	char *packet_buffer;
 };
 
 #if 0
@@ -149,6 +157,10 @@ static int gdb_report_register_access_error;
 /* enabled by default */
 static bool gdb_use_target_description = true;
 
+/* largest packet GDB is allowed to send, applies to new connections */
+#define GDB_MAX_PACKET_SIZE_LIMIT (16 * 1024 * 1024)
+static unsigned int gdb_max_packet_size = GDB_BUFFER_SIZE;
+
 /* current processing free-run type, used by file-I/O */
 static char gdb_running_type;
 
@@ -248,14 +260,14 @@ static int gdb_get_char_inner(struct connection *connection, int *next_char)
 #endif
 	for (;; ) {
 		if (connection->service->type != CONNECTION_TCP)
-			gdb_con->buf_cnt = read(connection->fd, gdb_con->buffer, GDB_BUFFER_SIZE);
+			gdb_con->buf_cnt = read(connection->fd, gdb_con->buffer, gdb_con->packet_size);
 		else {
 			retval = check_pending(connection, 1, NULL);
 			if (retval != ERROR_OK)
 				return retval;
 			gdb_con->buf_cnt = read_socket(connection->fd,
 					gdb_con->buffer,
-					GDB_BUFFER_SIZE);
+					gdb_con->packet_size);
 		}
 
 		if (gdb_con->buf_cnt > 0)
@@ -578,6 +590,67 @@ int gdb_put_packet(struct connection *connection, const char *buffer, int len)
 	return retval;
 }
 
+/**
+ * Unescape the packet data in @a in up to the terminating '#', or up to
+ * @a size bytes. Plain runs are found with memchr() and copied at once.
+ * The byte following the last one may be read to complete an escape
+ * sequence starting at the end of the run.
+ *
+ * @param out receives the unescaped data, at least @a size bytes
+ * @param out_count set to the number of bytes stored in @a out
+ * @param checksum updated with the packet characters consumed
+ * @param done set when the terminating '#' has been consumed
+ * @returns the number of bytes consumed from @a in
+ */
+int gdb_unescape_run(const char *in, int size, char *out, int *out_count,
+		unsigned char *checksum, bool *done)
+{
+	const char *buf = in;
+	const char *end = in + size;
+	const char *hash = memchr(buf, '#', end - buf);
+	unsigned char my_checksum = *checksum;
+	int count = 0;
+
+	*done = false;
+	while (buf < end) {
+		const char *stop = hash ? hash : end;
+		const char *esc = memchr(buf, '}', stop - buf);
+		const char *plain_end = esc ? esc : stop;
+		int n = plain_end - buf;
+
+		memcpy(out + count, buf, n);
+		count += n;
+		for (int k = 0; k < n; k++)
+			my_checksum += buf[k];
+		buf = plain_end;
+
+		if (!esc) {
+			if (hash) {
+				/* skip the '#' */
+				buf++;
+				*done = true;
+			}
+			break;
+		}
+
+		/* data transmitted in binary mode (X packet)
+		 * uses 0x7d as escape character */
+		int character = buf[1] & 0xff;
+		my_checksum += '}';
+		my_checksum += character;
+		out[count++] = (character ^ 0x20) & 0xff;
+		buf += 2;
+
+		/* Danger! character can be '#' when esc is used */
+		if (hash && buf > hash)
+			hash = memchr(buf, '#', end - MIN(buf, end));
+	}
+
+	*checksum = my_checksum;
+	*out_count = count;
+	return buf - in;
+}
+
 static inline int fetch_packet(struct connection *connection,
 		int *checksum_ok, int noack, int *len, char *buffer)
 {
@@ -602,38 +675,14 @@ static inline int fetch_packet(struct connection *connection,
 		 * gdb_get_char() update various bits and bobs correctly.
 		 */
 		if ((buf_cnt > 2) && ((buf_cnt + count) < *len)) {
-			/* The compiler will struggle a bit with constant propagation and
-			 * aliasing, so we help it by showing that these values do not
-			 * change inside the loop
+			/* The 2 bytes left in the buffer allow reading the char
+			 * following a '}' found at the end of the run.
 			 */
-			int i;
-			char *buf = buf_p;
-			int run = buf_cnt - 2;
-			i = 0;
-			int done = 0;
-			while (i < run) {
-				character = *buf++;
-				i++;
-				if (character == '#') {
-					/* Danger! character can be '#' when esc is
-					 * used so we need an explicit boolean for done here. */
-					done = 1;
-					break;
-				}
-
-				if (character == '}') {
-					/* data transmitted in binary mode (X packet)
-					 * uses 0x7d as escape character */
-					my_checksum += character & 0xff;
-					character = *buf++;
-					i++;
-					my_checksum += character & 0xff;
-					buffer[count++] = (character ^ 0x20) & 0xff;
-				} else {
-					my_checksum += character & 0xff;
-					buffer[count++] = character & 0xff;
-				}
-			}
+			bool done;
+			int n;
+			int i = gdb_unescape_run(buf_p, buf_cnt - 2, buffer + count, &n,
+					&my_checksum, &done);
+			count += n;
 			buf_p += i;
 			buf_cnt -= i;
 			if (done)
@@ -1033,6 +1082,17 @@ static int gdb_new_connection(struct connection *connection)
 	connection->cmd_ctx->current_target = target;
 
 	/* initialize gdb connection information */
+	gdb_connection->packet_size = gdb_max_packet_size;
+	gdb_connection->buffer = malloc(gdb_connection->packet_size + 1);
+	gdb_connection->packet_buffer = malloc(gdb_connection->packet_size + 1);
+	if (!gdb_connection->buffer || !gdb_connection->packet_buffer) {
+		LOG_ERROR("Out of memory");
+		free(gdb_connection->buffer);
+		free(gdb_connection->packet_buffer);
+		free(gdb_connection);
+		connection->priv = NULL;
+		return ERROR_FAIL;
+	}
 	gdb_connection->buf_p = gdb_connection->buffer;
 	gdb_connection->buf_cnt = 0;
 	gdb_connection->ctrl_c = false;
@@ -1048,6 +1108,7 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->target_desc.tdesc = NULL;
 	gdb_connection->target_desc.tdesc_length = 0;
 	gdb_connection->thread_list = NULL;
+	gdb_connection->thread_list_generation = 0;
 	gdb_connection->output_flag = GDB_OUTPUT_NO;
 	gdb_connection->unique_index = next_unique_id++;
 
@@ -1163,6 +1224,9 @@ static int gdb_connection_closed(struct connection *connection)
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
 
+	free(gdb_connection->thread_list);
+	free(gdb_connection->buffer);
+	free(gdb_connection->packet_buffer);
 	free(connection->priv);
 	connection->priv = NULL;
 
@@ -1379,6 +1443,8 @@ static int gdb_set_registers_packet(struct connection *connection,
 	if (retval != ERROR_OK)
 		return gdb_error(connection, retval);
 
+	rtos_invalidate_reg_caches();
+
 	packet_p = packet;
 	for (i = 0; i < reg_list_size; i++) {
 		uint8_t *bin_buf;
@@ -1519,6 +1585,7 @@ static int gdb_set_register_packet(struct connection *connection,
 
 	gdb_target_to_reg(target, separator + 1, chars, bin_buf);
 
+	rtos_invalidate_reg_caches();
 	retval = reg_list[reg_num]->type->set(reg_list[reg_num], bin_buf);
 	if (retval != ERROR_OK && gdb_report_register_access_error) {
 		LOG_DEBUG("Couldn't set register %s.", reg_list[reg_num]->name);
@@ -2770,14 +2837,23 @@ static int gdb_generate_thread_list(struct target *target, char **thread_list_ou
 }
 
 static int gdb_get_thread_list_chunk(struct target *target, char **thread_list,
-		char **chunk, int32_t offset, uint32_t length)
+		unsigned int *generation, char **chunk, int32_t offset, uint32_t length)
 {
+	/* A transfer starting at offset 0 gets the XML of the current thread
+	 * list, which is only built again after the thread list changed. */
+	unsigned int current_generation = target->rtos ? target->rtos->thread_list_generation : 0;
+	if (*thread_list && offset == 0 && *generation != current_generation) {
+		free(*thread_list);
+		*thread_list = NULL;
+	}
+
 	if (!*thread_list) {
 		int retval = gdb_generate_thread_list(target, thread_list);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Unable to Generate Thread List");
 			return ERROR_FAIL;
 		}
+		*generation = current_generation;
 	}
 
 	size_t thread_list_length = strlen(*thread_list);
@@ -2803,12 +2879,6 @@ static int gdb_get_thread_list_chunk(struct target *target, char **thread_list,
 	strncpy((*chunk) + 1, (*thread_list) + offset, length);
 	(*chunk)[1 + length] = '\0';
 
-	/* After gdb-server sends out last chunk, invalidate thread list. */
-	if (transfer_type == 'l') {
-		free(*thread_list);
-		*thread_list = NULL;
-	}
-
 	return ERROR_OK;
 }
 
@@ -2959,7 +3029,7 @@ static int gdb_query_packet(struct connection *connection,
 			&pos,
 			&size,
 			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+",
-			GDB_BUFFER_SIZE,
+			gdb_connection->packet_size,
 			(gdb_use_memory_map && (flash_get_bank_count() > 0)) ? '+' : '-',
 			gdb_target_desc_supported ? '+' : '-');
 
@@ -3027,7 +3097,7 @@ static int gdb_query_packet(struct connection *connection,
 		 * chunk of target description.
 		 */
 		retval = gdb_get_thread_list_chunk(target, &gdb_connection->thread_list,
-						   &xml, offset, length);
+						   &gdb_connection->thread_list_generation, &xml, offset, length);
 		if (retval != ERROR_OK) {
 			gdb_error(connection, retval);
 			return retval;
@@ -3585,14 +3655,12 @@ static void gdb_sig_halted(struct connection *connection)
 
 static int gdb_input_inner(struct connection *connection)
 {
-	/* Do not allocate this on the stack */
-	static char gdb_packet_buffer[GDB_BUFFER_SIZE + 1]; /* Extra byte for null-termination */
-
 	struct target *target;
-	char const *packet = gdb_packet_buffer;
 	int packet_size;
 	int retval;
 	struct gdb_connection *gdb_con = connection->priv;
+	char *gdb_packet_buffer = gdb_con->packet_buffer;
+	char const *packet = gdb_packet_buffer;
 	static bool warn_use_ext;
 
 	target = get_target_from_connection(connection);
@@ -3609,7 +3677,7 @@ static int gdb_input_inner(struct connection *connection)
 	 * drain the rest of the buffer.
 	 */
 	do {
-		packet_size = GDB_BUFFER_SIZE;
+		packet_size = gdb_con->packet_size;
 		retval = gdb_get_packet(connection, gdb_packet_buffer, &packet_size);
 		if (retval != ERROR_OK)
 			return retval;
@@ -4140,6 +4208,27 @@ COMMAND_HANDLER(handle_gdb_target_description_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_max_packet_size_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int size;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], size);
+		if (size < GDB_BUFFER_SIZE || size > GDB_MAX_PACKET_SIZE_LIMIT) {
+			command_print(CMD, "packet size must be between %u and %u",
+				GDB_BUFFER_SIZE, GDB_MAX_PACKET_SIZE_LIMIT);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		gdb_max_packet_size = size;
+	}
+
+	command_print(CMD, "%u", gdb_max_packet_size);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 {
 	char *tdesc;
@@ -4250,6 +4339,14 @@ static const struct command_registration gdb_subcommand_handlers[] = {
 		.help = "enable or disable target description",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "max_packet_size",
+		.handler = handle_gdb_max_packet_size_command,
+		.mode = COMMAND_ANY,
+		.help = "Display or set the largest packet GDB may send, "
+			"used by new GDB connections",
+		.usage = "[size]",
+	},
 	{
 		.name = "save_tdesc",
 		.handler = handle_gdb_save_tdesc_command,
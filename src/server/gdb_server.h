@@ -29,6 +29,8 @@ int gdb_register_commands(struct command_context *command_context);
 void gdb_service_free(void);
 
 int gdb_put_packet(struct connection *connection, const char *buffer, int len);
+int gdb_unescape_run(const char *in, int size, char *out, int *out_count,
+		unsigned char *checksum, bool *done);
 
 int gdb_get_actual_connections(void);
 
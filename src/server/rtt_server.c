@@ -35,7 +35,7 @@ struct rtt_connection_data {
 };
 
 static int read_callback(unsigned int channel, const uint8_t *buffer,
-		size_t length, void *user_data)
+		size_t length, size_t *written, void *user_data)
 {
 	int ret;
 	struct connection *connection;
@@ -49,12 +49,14 @@ static int read_callback(unsigned int channel, const uint8_t *buffer,
 
 		if (ret < 0) {
 			LOG_ERROR("Failed to write data to socket.");
+			*written = offset;
 			return ERROR_FAIL;
 		}
 
 		offset += ret;
 	}
 
+	*written = offset;
 	return ERROR_OK;
 }
 
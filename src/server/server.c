@@ -28,6 +28,10 @@
 
 #include <signal.h>
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #ifdef HAVE_NETDB_H
 #include <netdb.h>
 #endif
@@ -59,6 +63,295 @@ static int polling_period = 100;
 /* address by name on which to listen for incoming TCP/IP connections */
 static char *bindto_name;
 
+/*
+ * The server loop does not rebuild an fd_set of every service and connection
+ * on each iteration. Instead file descriptors are registered with an event
+ * backend when a service or connection is created and unregistered when it
+ * is closed. The backend reports readiness by setting the flag passed along
+ * with each file descriptor.
+ */
+struct server_event_backend {
+	const char *name;
+	/** prepare the backend, returns ERROR_OK or ERROR_FAIL */
+	int (*init)(void);
+	/** release all resources of the backend */
+	void (*quit)(void);
+	/** start watching @a fd; @a ready is set to true when fd is readable */
+	int (*add_fd)(int fd, bool *ready);
+	/** stop watching @a fd */
+	void (*del_fd)(int fd);
+	/**
+	 * Wait up to @a timeout_ms for any registered fd to become readable.
+	 * Returns the number of ready fds, 0 on timeout or -1 on error
+	 * with errno set.
+	 */
+	int (*wait)(int timeout_ms);
+};
+
+struct server_event_fd {
+	int fd;
+	bool *ready;
+};
+
+/* Grow-only table of watched fds, used by the select() backend and for the
+ * fds epoll refuses to watch (e.g. stdin redirected from a regular file). */
+struct server_event_fd_table {
+	struct server_event_fd *fds;
+	unsigned int count;
+	unsigned int size;
+};
+
+static int fd_table_add(struct server_event_fd_table *t, int fd, bool *ready)
+{
+	if (t->count == t->size) {
+		unsigned int new_size = t->size ? 2 * t->size : 16;
+		struct server_event_fd *new_fds = realloc(t->fds, new_size * sizeof(*new_fds));
+		if (!new_fds) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		t->fds = new_fds;
+		t->size = new_size;
+	}
+	t->fds[t->count].fd = fd;
+	t->fds[t->count].ready = ready;
+	t->count++;
+
+	return ERROR_OK;
+}
+
+static bool fd_table_del(struct server_event_fd_table *t, int fd)
+{
+	for (unsigned int i = 0; i < t->count; i++) {
+		if (t->fds[i].fd == fd) {
+			t->fds[i] = t->fds[--t->count];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void fd_table_free(struct server_event_fd_table *t)
+{
+	free(t->fds);
+	t->fds = NULL;
+	t->count = 0;
+	t->size = 0;
+}
+
+static struct server_event_fd_table select_fds;
+
+static int select_backend_init(void)
+{
+	return ERROR_OK;
+}
+
+static void select_backend_quit(void)
+{
+	fd_table_free(&select_fds);
+}
+
+static int select_backend_add_fd(int fd, bool *ready)
+{
+	return fd_table_add(&select_fds, fd, ready);
+}
+
+static void select_backend_del_fd(int fd)
+{
+	fd_table_del(&select_fds, fd);
+}
+
+static int select_backend_wait(int timeout_ms)
+{
+	fd_set read_fds;
+	int fd_max = 0;
+
+	FD_ZERO(&read_fds);
+	for (unsigned int i = 0; i < select_fds.count; i++) {
+		OCD_FD_SET(select_fds.fds[i].fd, &read_fds);
+		if (select_fds.fds[i].fd > fd_max)
+			fd_max = select_fds.fds[i].fd;
+	}
+
+	struct timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	int retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+	if (retval == -1) {
+#ifdef _WIN32
+		errno = WSAGetLastError();
+		if (errno == WSAEINTR)
+			errno = EINTR;
+#endif
+		return -1;
+	}
+
+	/* eCos leaves read_fds unchanged on timeout */
+	if (retval == 0)
+		return 0;
+
+	for (unsigned int i = 0; i < select_fds.count; i++)
+		if (OCD_FD_ISSET(select_fds.fds[i].fd, &read_fds))
+			*select_fds.fds[i].ready = true;
+
+	return retval;
+}
+
+static const struct server_event_backend select_backend = {
+	.name = "select",
+	.init = select_backend_init,
+	.quit = select_backend_quit,
+	.add_fd = select_backend_add_fd,
+	.del_fd = select_backend_del_fd,
+	.wait = select_backend_wait,
+};
+
+#ifdef HAVE_SYS_EPOLL_H
+#define EPOLL_MAX_EVENTS	32
+
+static int epoll_fd = -1;
+/* fds that epoll rejects with EPERM, they are always readable */
+static struct server_event_fd_table epoll_always_ready_fds;
+
+static int epoll_backend_init(void)
+{
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1) {
+		LOG_DEBUG("epoll_create1() failed: %s", strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static void epoll_backend_quit(void)
+{
+	if (epoll_fd != -1)
+		close(epoll_fd);
+	epoll_fd = -1;
+	fd_table_free(&epoll_always_ready_fds);
+}
+
+static int epoll_backend_add_fd(int fd, bool *ready)
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.ptr = ready,
+	};
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0)
+		return ERROR_OK;
+
+	if (errno == EPERM)
+		return fd_table_add(&epoll_always_ready_fds, fd, ready);
+
+	LOG_ERROR("couldn't watch fd %d: %s", fd, strerror(errno));
+	return ERROR_FAIL;
+}
+
+static void epoll_backend_del_fd(int fd)
+{
+	if (fd_table_del(&epoll_always_ready_fds, fd))
+		return;
+
+	/* fds that are already closed have been dropped by the kernel */
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+static int epoll_backend_wait(int timeout_ms)
+{
+	struct epoll_event events[EPOLL_MAX_EVENTS];
+
+	if (epoll_always_ready_fds.count)
+		timeout_ms = 0;
+
+	int retval = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, timeout_ms);
+	if (retval == -1)
+		return -1;
+
+	/* EPOLLHUP and EPOLLERR are reported as readable, the input handler
+	 * then sees the error or end of file */
+	for (int i = 0; i < retval; i++)
+		*(bool *)events[i].data.ptr = true;
+
+	for (unsigned int i = 0; i < epoll_always_ready_fds.count; i++)
+		*epoll_always_ready_fds.fds[i].ready = true;
+
+	return retval + epoll_always_ready_fds.count;
+}
+
+static const struct server_event_backend epoll_backend = {
+	.name = "epoll",
+	.init = epoll_backend_init,
+	.quit = epoll_backend_quit,
+	.add_fd = epoll_backend_add_fd,
+	.del_fd = epoll_backend_del_fd,
+	.wait = epoll_backend_wait,
+};
+#endif
+
+static const struct server_event_backend *server_event_backends[] = {
+#ifdef HAVE_SYS_EPOLL_H
+	&epoll_backend,
+#endif
+	&select_backend,
+};
+
+static const struct server_event_backend *event_backend;
+
+/* statistics of server_loop(), reported by the 'server_stats' command */
+static struct {
+	uint64_t loop_iterations;
+	uint64_t ready_wakeups;
+	uint64_t timeout_wakeups;
+	uint64_t timer_wakeups;
+	/* how late, in ms, the loop woke up after a target timer deadline */
+	int64_t timer_latency_total;
+	int64_t timer_latency_max;
+} server_stats;
+
+static const struct server_event_backend *server_event_backend(void)
+{
+	if (event_backend)
+		return event_backend;
+
+	for (size_t i = 0; i < ARRAY_SIZE(server_event_backends); i++) {
+		if (server_event_backends[i]->init() == ERROR_OK) {
+			event_backend = server_event_backends[i];
+			LOG_DEBUG("using '%s' server event backend", event_backend->name);
+			break;
+		}
+	}
+
+	/* the select() backend cannot fail */
+	assert(event_backend);
+	return event_backend;
+}
+
+static void server_event_quit(void)
+{
+	if (event_backend)
+		event_backend->quit();
+	event_backend = NULL;
+}
+
+static int server_watch_fd(int fd, bool *ready)
+{
+	*ready = false;
+	if (fd == -1)
+		return ERROR_OK;
+	return server_event_backend()->add_fd(fd, ready);
+}
+
+static void server_unwatch_fd(int fd)
+{
+	if (fd != -1 && event_backend)
+		event_backend->del_fd(fd);
+}
+
+static int remove_connection(struct service *service, struct connection *connection);
+
 static int add_connection(struct service *service, struct command_context *cmd_ctx)
 {
 	socklen_t address_size;
@@ -73,6 +366,7 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	c->cmd_ctx = copy_command_context(cmd_ctx);
 	c->service = service;
 	c->input_pending = false;
+	c->input_ready = false;
 	c->priv = NULL;
 	c->next = NULL;
 
@@ -112,6 +406,7 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 #endif
 
 		/* do not check for new connections again on stdin */
+		server_unwatch_fd(service->fd);
 		service->fd = -1;
 
 		LOG_INFO("accepting '%s' connection from pipe", service->name);
@@ -125,6 +420,7 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	} else if (service->type == CONNECTION_PIPE) {
 		c->fd = service->fd;
 		/* do not check for new connections again on stdin */
+		server_unwatch_fd(service->fd);
 		service->fd = -1;
 
 		char *out_file = alloc_printf("%so", service->port);
@@ -155,6 +451,12 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	if (service->max_connections != CONNECTION_LIMIT_UNLIMITED)
 		service->max_connections--;
 
+	if (server_watch_fd(c->fd, &c->input_ready) != ERROR_OK) {
+		LOG_ERROR("dropped '%s' connection", service->name);
+		remove_connection(service, c);
+		return ERROR_FAIL;
+	}
+
 	return ERROR_OK;
 }
 
@@ -168,11 +470,14 @@ static int remove_connection(struct service *service, struct connection *connect
 		if (c->fd == connection->fd) {
 			if (service->connection_closed)
 				service->connection_closed(c);
+			server_unwatch_fd(c->fd);
 			if (service->type == CONNECTION_TCP)
 				close_socket(c->fd);
 			else if (service->type == CONNECTION_PIPE) {
 				/* The service will listen to the pipe again */
 				c->service->fd = c->fd;
+				if (server_watch_fd(c->service->fd, &c->service->accept_ready) != ERROR_OK)
+					LOG_ERROR("'%s' stops listening on pipe %s", service->name, service->port);
 			}
 
 			command_done(c->cmd_ctx);
@@ -196,6 +501,7 @@ static int remove_connection(struct service *service, struct connection *connect
 
 static void free_service(struct service *c)
 {
+	server_unwatch_fd(c->fd);
 	if (c->type == CONNECTION_PIPE && c->fd != -1)
 		close(c->fd);
 	if (c->type == CONNECTION_TCP && c->fd != -1)
@@ -225,6 +531,7 @@ int add_service(const struct service_driver *driver, const char *port,
 	c->port = strdup(port);
 	c->max_connections = 1;	/* Only TCP/IP ports can support more than one connection */
 	c->fd = -1;
+	c->accept_ready = false;
 	c->connections = NULL;
 	c->new_connection_during_keep_alive = driver->new_connection_during_keep_alive_handler;
 	c->new_connection = driver->new_connection_handler;
@@ -348,6 +655,14 @@ int add_service(const struct service_driver *driver, const char *port,
 #endif
 	}
 
+	if (server_watch_fd(c->fd, &c->accept_ready) != ERROR_OK) {
+		if (c->type == CONNECTION_TCP)
+			close_socket(c->fd);
+		else if (c->type == CONNECTION_PIPE)
+			close(c->fd);
+		goto error;
+	}
+
 	/* add to the end of linked list */
 	for (p = &services; *p; p = &(*p)->next)
 		;
@@ -395,8 +710,10 @@ int remove_service(const char *name, const char *port)
 			else
 				prev->next = tmp->next;
 
-			if (tmp->type != CONNECTION_STDINOUT)
+			if (tmp->type != CONNECTION_STDINOUT) {
+				server_unwatch_fd(tmp->fd);
 				close_socket(tmp->fd);
+			}
 
 			free_service(tmp);
 
@@ -440,10 +757,6 @@ void server_loop(struct command_context *command_context)
 
 	bool poll_ok = true;
 
-	/* used in select() */
-	fd_set read_fds;
-	int fd_max;
-
 	/* used in accept() */
 	int retval;
 
@@ -454,94 +767,69 @@ void server_loop(struct command_context *command_context)
 		LOG_ERROR("couldn't set SIGPIPE to SIG_IGN");
 #endif
 
-	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
-		/* monitor sockets for activity */
-		fd_max = 0;
-		FD_ZERO(&read_fds);
-
-		/* add service and connection fds to read_fds */
-		for (service = services; service; service = service->next) {
-			if (service->fd != -1) {
-				/* listen for new connections */
-				OCD_FD_SET(service->fd, &read_fds);
+	const struct server_event_backend *backend = server_event_backend();
 
-				if (service->fd > fd_max)
-					fd_max = service->fd;
-			}
-
-			if (service->connections) {
-				struct connection *c;
-
-				for (c = service->connections; c; c = c->next) {
-					/* check for activity on the connection */
-					OCD_FD_SET(c->fd, &read_fds);
-					if (c->fd > fd_max)
-						fd_max = c->fd;
-				}
-			}
-		}
-
-		struct timeval tv;
-		tv.tv_sec = 0;
-		if (poll_ok) {
-			/* we're just polling this iteration, this is faster on embedded
-			 * hosts */
-			tv.tv_usec = 0;
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
-		} else {
-			/* Timeout socket_select() when a target timer expires or every polling_period */
-			int timeout_ms = next_event - timeval_ms();
-			if (timeout_ms < 0)
+	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
+		server_stats.loop_iterations++;
+
+		/* Service and connection fds are registered with the event backend
+		 * when they are created, just wait for activity on them.
+		 * If poll_ok is set we're just polling this iteration, this is
+		 * faster on embedded hosts. */
+		int timeout_ms = 0;
+		bool timer_deadline = false;
+		if (!poll_ok) {
+			/* Timeout when a target timer expires or every polling_period */
+			timeout_ms = next_event - timeval_ms();
+			if (timeout_ms < 0) {
 				timeout_ms = 0;
-			else if (timeout_ms > polling_period)
+			} else if (timeout_ms > polling_period) {
 				timeout_ms = polling_period;
-			tv.tv_usec = timeout_ms * 1000;
-			/* Only while we're sleeping we'll let others run */
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			} else {
+				timer_deadline = true;
+			}
 		}
 
-		if (retval == -1) {
-#ifdef _WIN32
-
-			errno = WSAGetLastError();
-
-			if (errno == WSAEINTR)
-				FD_ZERO(&read_fds);
-			else {
-				LOG_ERROR("error during select: %s", strerror(errno));
-				shutdown_openocd = SHUTDOWN_WITH_ERROR_CODE;
-				openocd_exit_status_code = EXIT_FAILURE;
-				return;
-			}
-#else
+		/* Only while we're sleeping we'll let others run */
+		retval = backend->wait(timeout_ms);
 
-			if (errno == EINTR)
-				FD_ZERO(&read_fds);
-			else {
-				LOG_ERROR("error during select: %s", strerror(errno));
+		if (retval == -1) {
+			if (errno != EINTR) {
+				LOG_ERROR("error during %s: %s", backend->name, strerror(errno));
 				shutdown_openocd = SHUTDOWN_WITH_ERROR_CODE;
 				openocd_exit_status_code = EXIT_FAILURE;
 				return;
 			}
-#endif
 		}
 
 		if (retval == 0) {
+			if (timer_deadline) {
+				int64_t latency = timeval_ms() - next_event;
+				if (latency > 0) {
+					server_stats.timer_latency_total += latency;
+					if (latency > server_stats.timer_latency_max)
+						server_stats.timer_latency_max = latency;
+				}
+				server_stats.timer_wakeups++;
+			}
+			if (!poll_ok)
+				server_stats.timeout_wakeups++;
+
 			/* Execute callbacks of expired timers when
 			 * - there was nothing to do if poll_ok was true
-			 * - socket_select() timed out if poll_ok was false, now one or more
+			 * - the backend timed out if poll_ok was false, now one or more
 			 *   timers expired or the polling period elapsed
 			 */
 			target_call_timer_callbacks();
 			next_event = target_timer_next_event();
 			process_jim_events(command_context);
 
-			FD_ZERO(&read_fds);	/* eCos leaves read_fds unchanged in this case!  */
-
 			/* We timed out/there was nothing to do, timeout rather than poll next time
 			 **/
 			poll_ok = false;
 		} else {
+			if (retval > 0)
+				server_stats.ready_wakeups++;
 			/* There was something to do, next time we'll just poll */
 			poll_ok = true;
 		}
@@ -555,8 +843,8 @@ void server_loop(struct command_context *command_context)
 
 		for (service = services; service; service = service->next) {
 			/* handle new connections on listeners */
-			if ((service->fd != -1)
-				&& (OCD_FD_ISSET(service->fd, &read_fds))) {
+			if (service->fd != -1 && service->accept_ready) {
+				service->accept_ready = false;
 				if (service->max_connections != 0)
 					add_connection(service, command_context);
 				else {
@@ -580,7 +868,8 @@ void server_loop(struct command_context *command_context)
 				struct connection *c;
 
 				for (c = service->connections; c; ) {
-					if ((c->fd >= 0 && OCD_FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
+					if ((c->fd >= 0 && c->input_ready) || c->input_pending) {
+						c->input_ready = false;
 						retval = service->input(c);
 						if (retval != ERROR_OK) {
 							struct connection *next = c->next;
@@ -739,6 +1028,7 @@ int server_init(struct command_context *cmd_ctx)
 void server_quit(void)
 {
 	remove_services();
+	server_event_quit();
 	target_quit();
 
 #ifdef _WIN32
@@ -859,6 +1149,32 @@ COMMAND_HANDLER(handle_poll_period_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_server_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(&server_stats, 0, sizeof(server_stats));
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "event backend:       %s",
+		event_backend ? event_backend->name : "none");
+	command_print(CMD, "loop iterations:     %" PRIu64, server_stats.loop_iterations);
+	command_print(CMD, "wakeups on activity: %" PRIu64, server_stats.ready_wakeups);
+	command_print(CMD, "wakeups on timeout:  %" PRIu64, server_stats.timeout_wakeups);
+	command_print(CMD, "timer deadlines:     %" PRIu64, server_stats.timer_wakeups);
+	if (server_stats.timer_wakeups)
+		command_print(CMD, "timer wakeup latency: avg %" PRId64 " ms, max %" PRId64 " ms",
+			server_stats.timer_latency_total / (int64_t)server_stats.timer_wakeups,
+			server_stats.timer_latency_max);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_bindto_command)
 {
 	switch (CMD_ARGC) {
@@ -942,6 +1258,13 @@ static const struct command_registration server_command_handlers[] = {
 		.usage = "",
 		.help = "set the servers polling period",
 	},
+	{
+		.name = "server_stats",
+		.handler = &handle_server_stats_command,
+		.mode = COMMAND_ANY,
+		.usage = "['reset']",
+		.help = "show or reset the statistics of the server event loop",
+	},
 	{
 		.name = "bindto",
 		.handler = &handle_bindto_command,
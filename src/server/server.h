@@ -40,6 +40,8 @@ struct connection {
 	struct command_context *cmd_ctx;
 	struct service *service;
 	bool input_pending;
+	/** set by the server event backend when @a fd became readable */
+	bool input_ready;
 	void *priv;
 	struct connection *next;
 };
@@ -78,6 +80,8 @@ struct service {
 	/** If port is an integer it is parsed and saved here. */
 	unsigned short portnumber;
 	int fd;
+	/** set by the server event backend when @a fd became readable */
+	bool accept_ready;
 	struct sockaddr_in sin;
 	int max_connections;
 	struct connection *connections;
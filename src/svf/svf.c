@@ -238,6 +238,65 @@ static long svf_total_lines;
 static int svf_percentage;
 static int svf_last_printed_percentage = -1;
 
+/* Pre-parsed command stream. With -preparse the whole file is parsed into
+ * these records before any JTAG operation is queued, see svf_run_ops(). */
+enum svf_op_type {
+	SVF_OP_TLR,
+	SVF_OP_PATHMOVE,
+	SVF_OP_IR_SCAN,
+	SVF_OP_DR_SCAN,
+	SVF_OP_CLOCKS,
+	SVF_OP_SLEEP,
+	SVF_OP_TRST,
+	SVF_OP_FREQUENCY,
+};
+
+struct svf_op {
+	uint8_t type;		/* enum svf_op_type */
+	uint8_t end_state;	/* end state of scans */
+	uint8_t check;		/* scan has TDO and MASK to check */
+	int line_num;		/* line number in the SVF file */
+	uint32_t value;		/* bits, states, cycles, microseconds, TRST or kHz */
+	size_t data_offset;	/* scan vectors or path states in svf_op_data */
+};
+
+#define SVF_OPS_MIN_ALLOC	1024
+/* longer paths are recorded as several consecutive path moves */
+#define SVF_OP_PATHMOVE_MAX	256
+static bool svf_preparse;
+static enum tap_state svf_preparse_state;
+static enum tap_state svf_preparse_start_state;
+static struct svf_op *svf_ops;
+static size_t svf_ops_count, svf_ops_alloc;
+static uint8_t *svf_op_data;
+static size_t svf_op_data_size, svf_op_data_alloc;
+
+/* Output of "svf compile", NULL when the stream is to be run */
+static const char *svf_compile_file;
+
+/*
+ * Compiled SVF file written by "svf compile" and run by "svf replay". All
+ * integers are little endian and every part starts 8-byte aligned, so the
+ * file can be used in place once mapped or read into memory:
+ *
+ *  0  char     magic[8]      SVF_COMPILED_MAGIC
+ *  8  uint32   version       SVF_COMPILED_VERSION
+ * 12  uint32   start_state   TAP state the stream was compiled for
+ * 16  uint32   op_count      number of operation records
+ * 20  uint32   line_count    lines of the SVF source, for -progress
+ * 24  uint64   data_size     size of the data section
+ * 32  op_count records of SVF_COMPILED_OP_SIZE bytes:
+ *      0 uint8 type, 1 uint8 end_state, 2 uint8 check, 3 uint8 reserved,
+ *      4 uint32 line_num, 8 uint32 value, 12 uint32 reserved,
+ *     16 uint64 data_offset
+ *     followed by the data section with the padded scan vectors (TDI, then
+ *     TDO and MASK of checked scans) and path states.
+ */
+#define SVF_COMPILED_MAGIC			"OCDSVFC"
+#define SVF_COMPILED_VERSION		1
+#define SVF_COMPILED_HEADER_SIZE	32
+#define SVF_COMPILED_OP_SIZE		24
+
 /*
  * macro is used to print the svf hex buffer at desired debug level
  * DEBUG, INFO, ERROR, USER
@@ -313,45 +372,515 @@ static void svf_free_xxd_para(struct svf_xxr_para *para)
 	}
 }
 
-int svf_add_statemove(enum tap_state state_to)
+static void svf_free_ops(void)
 {
-	enum tap_state state_from = cmd_queue_cur_state;
-	unsigned int index_var;
+	free(svf_ops);
+	svf_ops = NULL;
+	svf_ops_count = 0;
+	svf_ops_alloc = 0;
+
+	free(svf_op_data);
+	svf_op_data = NULL;
+	svf_op_data_size = 0;
+	svf_op_data_alloc = 0;
+}
 
-	/* when resetting, be paranoid and ignore current state */
-	if (state_to == TAP_RESET) {
-		if (svf_nil)
-			return ERROR_OK;
+/* Append a record to the command stream, reserving data_len bytes of data
+ * for it. Returns NULL if out of memory. */
+static struct svf_op *svf_new_op(enum svf_op_type type, uint32_t value, size_t data_len)
+{
+	if (svf_ops_count == svf_ops_alloc) {
+		size_t new_alloc = svf_ops_alloc ? 2 * svf_ops_alloc : SVF_OPS_MIN_ALLOC;
+		struct svf_op *new_ops = realloc(svf_ops, new_alloc * sizeof(*svf_ops));
+		if (!new_ops) {
+			LOG_ERROR("not enough memory");
+			return NULL;
+		}
+		svf_ops = new_ops;
+		svf_ops_alloc = new_alloc;
+	}
+
+	if (svf_op_data_size + data_len > svf_op_data_alloc) {
+		size_t new_alloc = MAX(2 * svf_op_data_alloc, svf_op_data_size + data_len);
+		uint8_t *new_data = realloc(svf_op_data, new_alloc);
+		if (!new_data) {
+			LOG_ERROR("not enough memory");
+			return NULL;
+		}
+		svf_op_data = new_data;
+		svf_op_data_alloc = new_alloc;
+	}
+
+	struct svf_op *op = &svf_ops[svf_ops_count++];
+	memset(op, 0, sizeof(*op));
+	op->type = type;
+	op->line_num = svf_line_number;
+	op->value = value;
+	op->data_offset = svf_op_data_size;
+	svf_op_data_size += data_len;
 
+	return op;
+}
+
+/* State the TAP is in after everything added so far */
+static enum tap_state svf_current_state(void)
+{
+	return svf_preparse ? svf_preparse_state : cmd_queue_cur_state;
+}
+
+static int svf_add_tlr(void)
+{
+	if (svf_preparse) {
+		if (!svf_new_op(SVF_OP_TLR, 0, 0))
+			return ERROR_FAIL;
+		svf_preparse_state = TAP_RESET;
+	} else if (!svf_nil) {
 		jtag_add_tlr();
+	}
+
+	return ERROR_OK;
+}
+
+static int svf_add_pathmove(unsigned int num_states, const enum tap_state *path)
+{
+	if (svf_preparse) {
+		svf_preparse_state = path[num_states - 1];
+		while (num_states > 0) {
+			unsigned int num = MIN(num_states, SVF_OP_PATHMOVE_MAX);
+			struct svf_op *op = svf_new_op(SVF_OP_PATHMOVE, num, num);
+			if (!op)
+				return ERROR_FAIL;
+			for (unsigned int i = 0; i < num; i++)
+				svf_op_data[op->data_offset + i] = path[i];
+			path += num;
+			num_states -= num;
+		}
+	} else if (!svf_nil) {
+		jtag_add_pathmove(num_states, path);
+	}
+
+	return ERROR_OK;
+}
+
+static int svf_add_clocks(unsigned int num_cycles)
+{
+	if (svf_preparse)
+		return svf_new_op(SVF_OP_CLOCKS, num_cycles, 0) ? ERROR_OK : ERROR_FAIL;
+
+	if (!svf_nil)
+		jtag_add_clocks(num_cycles);
+	return ERROR_OK;
+}
+
+static int svf_add_sleep(uint32_t us)
+{
+	if (svf_preparse)
+		return svf_new_op(SVF_OP_SLEEP, us, 0) ? ERROR_OK : ERROR_FAIL;
+
+	if (!svf_nil)
+		jtag_add_sleep(us);
+	return ERROR_OK;
+}
+
+/* Queue a TRST change, the caller has flushed the queue before */
+static int svf_add_trst(int trst)
+{
+	if (svf_preparse) {
+		if (!svf_new_op(SVF_OP_TRST, trst, 0))
+			return ERROR_FAIL;
+		/* like jtag_add_reset(), which falls back to a TLR without TRST */
+		if (trst)
+			svf_preparse_state = TAP_RESET;
+		return ERROR_OK;
+	}
+
+	if (!svf_nil)
+		jtag_add_reset(trst, 0);
+	return ERROR_OK;
+}
+
+/* Change the adapter speed, the caller has flushed the queue before */
+static int svf_set_frequency(struct command_context *cmd_ctx, int khz)
+{
+	if (svf_preparse)
+		return svf_new_op(SVF_OP_FREQUENCY, khz, 0) ? ERROR_OK : ERROR_FAIL;
+
+	command_run_linef(cmd_ctx, "adapter speed %d", khz);
+	return ERROR_OK;
+}
+
+/*
+ * Add the IR or DR scan assembled at svf_buffer_index. The TDI buffer also
+ * receives the captured TDO when check is set.
+ */
+static int svf_add_scan(bool ir_scan, int num_bits, bool check, enum tap_state end_state)
+{
+	int num_bytes = DIV_ROUND_UP(num_bits, 8);
+
+	if (svf_preparse) {
+		struct svf_op *op = svf_new_op(ir_scan ? SVF_OP_IR_SCAN : SVF_OP_DR_SCAN,
+				num_bits, (check ? 3 : 1) * num_bytes);
+		if (!op)
+			return ERROR_FAIL;
+		op->end_state = end_state;
+		op->check = check;
+		uint8_t *data = &svf_op_data[op->data_offset];
+		memcpy(data, &svf_tdi_buffer[svf_buffer_index], num_bytes);
+		if (check) {
+			memcpy(data + num_bytes, &svf_tdo_buffer[svf_buffer_index], num_bytes);
+			memcpy(data + 2 * num_bytes, &svf_mask_buffer[svf_buffer_index], num_bytes);
+		}
+		svf_preparse_state = end_state;
+		/* the assembly buffers are reused by the next scan */
 		return ERROR_OK;
 	}
 
+	svf_add_check_para(check, svf_buffer_index, num_bits);
+	if (!svf_nil) {
+		/* NOTE:  doesn't use SVF-specified state paths */
+		uint8_t *in_value = check ? &svf_tdi_buffer[svf_buffer_index] : NULL;
+		if (ir_scan)
+			jtag_add_plain_ir_scan(num_bits, &svf_tdi_buffer[svf_buffer_index],
+					in_value, end_state);
+		else
+			jtag_add_plain_dr_scan(num_bits, &svf_tdi_buffer[svf_buffer_index],
+					in_value, end_state);
+	}
+	svf_buffer_index += num_bytes;
+
+	return ERROR_OK;
+}
+
+int svf_add_statemove(enum tap_state state_to)
+{
+	enum tap_state state_from = svf_current_state();
+	unsigned int index_var;
+
+	/* when resetting, be paranoid and ignore current state */
+	if (state_to == TAP_RESET)
+		return svf_add_tlr();
+
 	for (index_var = 0; index_var < ARRAY_SIZE(svf_statemoves); index_var++) {
 		if ((svf_statemoves[index_var].from == state_from)
 				&& (svf_statemoves[index_var].to == state_to)) {
-			if (svf_nil)
+			if (svf_nil && !svf_preparse)
 				continue;
 						/* recorded path includes current state ... avoid
 						 *extra TCKs! */
 			if (svf_statemoves[index_var].num_of_moves > 1)
-				jtag_add_pathmove(svf_statemoves[index_var].num_of_moves - 1,
+				return svf_add_pathmove(svf_statemoves[index_var].num_of_moves - 1,
 					svf_statemoves[index_var].paths + 1);
 			else
-				jtag_add_pathmove(svf_statemoves[index_var].num_of_moves,
+				return svf_add_pathmove(svf_statemoves[index_var].num_of_moves,
 					svf_statemoves[index_var].paths);
-			return ERROR_OK;
 		}
 	}
 	LOG_ERROR("SVF: can not move to %s", tap_state_name(state_to));
 	return ERROR_FAIL;
 }
 
+/*
+ * Execute the pre-parsed command stream. Scan vectors are queued straight
+ * from the stream, only the expected TDO and MASK of checked scans are
+ * copied to the check buffers, so a mismatch is reported with the line
+ * number of the SVF file as in the direct mode.
+ */
+static int svf_run_ops(struct command_context *cmd_ctx)
+{
+	enum tap_state path[SVF_OP_PATHMOVE_MAX];
+	size_t queued_bytes = 0;
+
+	for (size_t i = 0; i < svf_ops_count; i++) {
+		const struct svf_op *op = &svf_ops[i];
+		const uint8_t *data = &svf_op_data[op->data_offset];
+		uint8_t *in_value = NULL;
+		int num_bytes;
+
+		svf_line_number = op->line_num;
+
+		switch (op->type) {
+		case SVF_OP_TLR:
+			jtag_add_tlr();
+			break;
+		case SVF_OP_PATHMOVE:
+			assert(op->value <= ARRAY_SIZE(path));
+			for (unsigned int j = 0; j < op->value; j++)
+				path[j] = data[j];
+			jtag_add_pathmove(op->value, path);
+			break;
+		case SVF_OP_CLOCKS:
+			jtag_add_clocks(op->value);
+			break;
+		case SVF_OP_SLEEP:
+			jtag_add_sleep(op->value);
+			break;
+		case SVF_OP_TRST:
+			if (svf_execute_tap() != ERROR_OK)
+				return ERROR_FAIL;
+			jtag_add_reset(op->value, 0);
+			break;
+		case SVF_OP_FREQUENCY:
+			if (svf_execute_tap() != ERROR_OK)
+				return ERROR_FAIL;
+			command_run_linef(cmd_ctx, "adapter speed %" PRIu32, op->value);
+			break;
+		case SVF_OP_IR_SCAN:
+		case SVF_OP_DR_SCAN:
+			num_bytes = DIV_ROUND_UP(op->value, 8);
+			if (op->check) {
+				if (svf_buffer_size - svf_buffer_index < num_bytes) {
+					if (svf_realloc_buffers(svf_buffer_index + num_bytes) != ERROR_OK) {
+						LOG_ERROR("not enough memory");
+						return ERROR_FAIL;
+					}
+				}
+				memcpy(&svf_tdo_buffer[svf_buffer_index], data + num_bytes, num_bytes);
+				memcpy(&svf_mask_buffer[svf_buffer_index], data + 2 * num_bytes, num_bytes);
+				if (svf_add_check_para(1, svf_buffer_index, op->value) != ERROR_OK)
+					return ERROR_FAIL;
+				in_value = &svf_tdi_buffer[svf_buffer_index];
+				svf_buffer_index += num_bytes;
+			}
+			if (op->type == SVF_OP_IR_SCAN)
+				jtag_add_plain_ir_scan(op->value, data, in_value, op->end_state);
+			else
+				jtag_add_plain_dr_scan(op->value, data, in_value, op->end_state);
+			queued_bytes += num_bytes;
+
+			/* same commit points as the direct mode */
+			if (queued_bytes >= SVF_MAX_BUFFER_SIZE_TO_COMMIT ||
+					svf_check_tdo_para_index >= SVF_CHECK_TDO_PARA_SIZE / 2) {
+				if (svf_execute_tap() != ERROR_OK)
+					return ERROR_FAIL;
+				queued_bytes = 0;
+			}
+			break;
+		default:
+			LOG_ERROR("BUG: unknown SVF operation %d", op->type);
+			return ERROR_FAIL;
+		}
+
+		if (svf_progress_enabled) {
+			svf_percentage = ((svf_line_number * 20) / svf_total_lines) * 5;
+			if (svf_last_printed_percentage != svf_percentage) {
+				LOG_USER_N("\r%d%%    ", svf_percentage);
+				svf_last_printed_percentage = svf_percentage;
+			}
+		}
+	}
+
+	return ERROR_OK;
+}
+
+/* Data section bytes used by an operation record */
+static size_t svf_op_data_len(const struct svf_op *op)
+{
+	switch (op->type) {
+	case SVF_OP_PATHMOVE:
+		return op->value;
+	case SVF_OP_IR_SCAN:
+	case SVF_OP_DR_SCAN:
+		return (op->check ? 3 : 1) * (size_t)DIV_ROUND_UP(op->value, 8);
+	default:
+		return 0;
+	}
+}
+
+static int svf_write_compiled(const char *filename)
+{
+	uint8_t header[SVF_COMPILED_HEADER_SIZE] = { 0 };
+	uint8_t record[SVF_COMPILED_OP_SIZE];
+
+	FILE *fd = fopen(filename, "wb");
+	if (!fd) {
+		LOG_ERROR("open(\"%s\"): %s", filename, strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	memcpy(header, SVF_COMPILED_MAGIC, sizeof(SVF_COMPILED_MAGIC));
+	h_u32_to_le(header + 8, SVF_COMPILED_VERSION);
+	h_u32_to_le(header + 12, svf_preparse_start_state);
+	h_u32_to_le(header + 16, svf_ops_count);
+	h_u32_to_le(header + 20, svf_line_number);
+	h_u64_to_le(header + 24, svf_op_data_size);
+	bool ok = fwrite(header, sizeof(header), 1, fd) == 1;
+
+	for (size_t i = 0; ok && i < svf_ops_count; i++) {
+		const struct svf_op *op = &svf_ops[i];
+		memset(record, 0, sizeof(record));
+		record[0] = op->type;
+		record[1] = op->end_state;
+		record[2] = op->check;
+		h_u32_to_le(record + 4, op->line_num);
+		h_u32_to_le(record + 8, op->value);
+		h_u64_to_le(record + 16, op->data_offset);
+		ok = fwrite(record, sizeof(record), 1, fd) == 1;
+	}
+
+	if (ok && svf_op_data_size)
+		ok = fwrite(svf_op_data, svf_op_data_size, 1, fd) == 1;
+
+	if (fclose(fd) != 0)
+		ok = false;
+
+	if (!ok) {
+		LOG_ERROR("failed to write \"%s\"", filename);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+/* Check the TAP states of a record read from a compiled file, which are
+ * used by the drivers to index their state tables */
+static bool svf_compiled_states_valid(const struct svf_op *op, const uint8_t *data)
+{
+	switch (op->type) {
+	case SVF_OP_PATHMOVE:
+		/* a long path is split, only its last part ends in a stable state */
+		for (uint32_t i = 0; i < op->value; i++)
+			if (data[i] > TAP_RESET)
+				return false;
+		return true;
+	case SVF_OP_IR_SCAN:
+	case SVF_OP_DR_SCAN:
+		return svf_tap_state_is_stable(op->end_state);
+	default:
+		return true;
+	}
+}
+
+/*
+ * Load a file written by svf_write_compiled() into the command stream.
+ * The records are validated so that a damaged file cannot make
+ * svf_run_ops() access memory outside the data section nor queue
+ * invalid TAP states.
+ */
+static int svf_read_compiled(const char *filename, enum tap_state *start_state,
+		long *line_count)
+{
+	uint8_t header[SVF_COMPILED_HEADER_SIZE];
+	uint8_t *records = NULL;
+	int retval = ERROR_FAIL;
+
+	FILE *fd = fopen(filename, "rb");
+	if (!fd) {
+		LOG_ERROR("open(\"%s\"): %s", filename, strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	if (fread(header, sizeof(header), 1, fd) != 1 ||
+			memcmp(header, SVF_COMPILED_MAGIC, sizeof(SVF_COMPILED_MAGIC))) {
+		LOG_ERROR("\"%s\" is not a compiled SVF file", filename);
+		goto out;
+	}
+	if (le_to_h_u32(header + 8) != SVF_COMPILED_VERSION) {
+		LOG_ERROR("\"%s\" has unsupported version %" PRIu32, filename,
+				le_to_h_u32(header + 8));
+		goto out;
+	}
+
+	uint32_t state = le_to_h_u32(header + 12);
+	if (state > TAP_RESET) {
+		LOG_ERROR("\"%s\" has invalid start state %" PRIu32, filename, state);
+		goto out;
+	}
+	*start_state = state;
+	uint32_t op_count = le_to_h_u32(header + 16);
+	*line_count = le_to_h_u32(header + 20);
+	uint64_t data_size = le_to_h_u64(header + 24);
+
+	svf_ops = calloc(MAX(op_count, 1), sizeof(*svf_ops));
+	records = malloc(MAX(op_count, 1) * (size_t)SVF_COMPILED_OP_SIZE);
+	svf_op_data = data_size <= SIZE_MAX ? malloc(MAX(data_size, 1)) : NULL;
+	if (!svf_ops || !records || !svf_op_data) {
+		LOG_ERROR("not enough memory");
+		goto out;
+	}
+	svf_ops_alloc = MAX(op_count, 1);
+	svf_op_data_alloc = MAX(data_size, 1);
+
+	if ((op_count && fread(records, SVF_COMPILED_OP_SIZE, op_count, fd) != op_count) ||
+			(data_size && fread(svf_op_data, data_size, 1, fd) != 1)) {
+		LOG_ERROR("\"%s\" is truncated", filename);
+		goto out;
+	}
+	svf_op_data_size = data_size;
+
+	for (uint32_t i = 0; i < op_count; i++) {
+		const uint8_t *record = records + i * SVF_COMPILED_OP_SIZE;
+		struct svf_op *op = &svf_ops[i];
+
+		op->type = record[0];
+		op->end_state = record[1];
+		op->check = record[2];
+		op->line_num = le_to_h_u32(record + 4);
+		op->value = le_to_h_u32(record + 8);
+		uint64_t data_offset = le_to_h_u64(record + 16);
+
+		if (op->type > SVF_OP_FREQUENCY ||
+				(op->type == SVF_OP_PATHMOVE && (op->value == 0 || op->value > SVF_OP_PATHMOVE_MAX)) ||
+				data_offset > data_size ||
+				svf_op_data_len(op) > data_size - data_offset ||
+				!svf_compiled_states_valid(op, svf_op_data + data_offset)) {
+			LOG_ERROR("\"%s\": invalid operation %" PRIu32, filename, i);
+			goto out;
+		}
+		op->data_offset = data_offset;
+	}
+	svf_ops_count = op_count;
+	retval = ERROR_OK;
+
+out:
+	free(records);
+	fclose(fd);
+	if (retval != ERROR_OK)
+		svf_free_ops();
+	return retval;
+}
+
+static void svf_free_run_buffers(void)
+{
+	free(svf_check_tdo_para);
+	svf_check_tdo_para = NULL;
+	svf_check_tdo_para_index = 0;
+
+	free(svf_tdi_buffer);
+	svf_tdi_buffer = NULL;
+
+	free(svf_tdo_buffer);
+	svf_tdo_buffer = NULL;
+
+	free(svf_mask_buffer);
+	svf_mask_buffer = NULL;
+
+	svf_buffer_index = 0;
+	svf_buffer_size = 0;
+}
+
+static void svf_print_time_used(struct command_invocation *cmd, int64_t time_measure_ms)
+{
+	int time_measure_s, time_measure_m;
+
+	time_measure_ms = timeval_ms() - time_measure_ms;
+	time_measure_s = time_measure_ms / 1000;
+	time_measure_ms %= 1000;
+	time_measure_m = time_measure_s / 60;
+	time_measure_s %= 60;
+	if (time_measure_ms < 1000)
+		command_print(CMD,
+			"\r\nTime used: %dm%ds%" PRId64 "ms ",
+			time_measure_m,
+			time_measure_s,
+			time_measure_ms);
+}
+
 enum svf_cmd_param {
 	OPT_ADDCYCLES,
 	OPT_IGNORE_ERROR,
 	OPT_NIL,
 	OPT_NORESET,
+	OPT_PREPARSE,
 	OPT_PROGRESS,
 	OPT_QUIET,
 	OPT_TAP,
@@ -367,6 +896,7 @@ static const struct nvp svf_cmd_opts[] = {
 	{ .name = "-ignore_error", .value = OPT_IGNORE_ERROR },
 	{ .name = "-nil",          .value = OPT_NIL },
 	{ .name = "-noreset",      .value = OPT_NORESET },
+	{ .name = "-preparse",     .value = OPT_PREPARSE },
 	{ .name = "-progress",     .value = OPT_PROGRESS },
 	{ .name = "-quiet",        .value = OPT_QUIET },
 	{ .name = "-tap",          .value = OPT_TAP },
@@ -381,11 +911,10 @@ static const struct nvp svf_cmd_opts[] = {
 COMMAND_HANDLER(handle_svf_command)
 {
 #define SVF_MIN_NUM_OF_OPTIONS 1
-#define SVF_MAX_NUM_OF_OPTIONS 8
+#define SVF_MAX_NUM_OF_OPTIONS 9
 	int command_num = 0;
 	int ret = ERROR_OK;
 	int64_t time_measure_ms;
-	int time_measure_s, time_measure_m;
 
 	/*
 	 * use NULL to indicate a "plain" svf file which accounts for
@@ -403,6 +932,7 @@ COMMAND_HANDLER(handle_svf_command)
 	svf_progress_enabled = 0;
 	svf_ignore_error = 0;
 	svf_noreset = false;
+	svf_preparse = svf_compile_file;
 	svf_addcycles = 0;
 
 	for (unsigned int i = 0; i < CMD_ARGC; i++) {
@@ -464,7 +994,17 @@ COMMAND_HANDLER(handle_svf_command)
 			svf_noreset = true;
 			break;
 
+		case OPT_PREPARSE:
+			svf_preparse = true;
+			break;
+
 		default:
+			if (svf_fd) {
+				command_print(CMD, "only one svf file can be processed");
+				fclose(svf_fd);
+				svf_fd = NULL;
+				return ERROR_COMMAND_SYNTAX_ERROR;
+			}
 			svf_fd = fopen(CMD_ARGV[i], "r");
 			if (!svf_fd) {
 				int err = errno;
@@ -507,9 +1047,14 @@ COMMAND_HANDLER(handle_svf_command)
 
 	memcpy(&svf_para, &svf_para_init, sizeof(svf_para));
 
-	if (!svf_nil && !svf_noreset) {
+	svf_preparse_state = cmd_queue_cur_state;
+	svf_preparse_start_state = svf_preparse_state;
+	if (!svf_noreset) {
 		/* TAP_RESET */
-		jtag_add_tlr();
+		if (svf_add_tlr() != ERROR_OK) {
+			ret = ERROR_FAIL;
+			goto free_all;
+		}
 	}
 
 	if (tap) {
@@ -571,7 +1116,7 @@ COMMAND_HANDLER(handle_svf_command)
 	while (svf_read_command_from_file(svf_fd) == ERROR_OK) {
 		/* Log Output */
 		if (svf_quiet) {
-			if (svf_progress_enabled) {
+			if (svf_progress_enabled && !svf_preparse) {
 				svf_percentage = ((svf_line_number * 20) / svf_total_lines) * 5;
 				if (svf_last_printed_percentage != svf_percentage) {
 					LOG_USER_N("\r%d%%    ", svf_percentage);
@@ -579,7 +1124,7 @@ COMMAND_HANDLER(handle_svf_command)
 				}
 			}
 		} else {
-			if (svf_progress_enabled) {
+			if (svf_progress_enabled && !svf_preparse) {
 				svf_percentage = ((svf_line_number * 20) / svf_total_lines) * 5;
 				LOG_USER_N("%3d%%  %s", svf_percentage, svf_read_line);
 			} else
@@ -594,23 +1139,29 @@ COMMAND_HANDLER(handle_svf_command)
 		command_num++;
 	}
 
-	if ((!svf_nil) && (jtag_execute_queue() != ERROR_OK))
-		ret = ERROR_FAIL;
-	else if (svf_check_tdo() != ERROR_OK)
-		ret = ERROR_FAIL;
+	if (svf_compile_file) {
+		/* svf compile: store the stream instead of running it */
+		if (ret == ERROR_OK)
+			ret = svf_write_compiled(svf_compile_file);
+	} else {
+		/* the whole file has been parsed, now run it */
+		if (ret == ERROR_OK && svf_preparse && !svf_nil) {
+			svf_preparse = false;
+			if (svf_run_ops(CMD_CTX) != ERROR_OK) {
+				LOG_ERROR("fail to run command at line %d", svf_line_number);
+				ret = ERROR_FAIL;
+			}
+		}
+		svf_preparse = false;
+
+		if ((!svf_nil) && (jtag_execute_queue() != ERROR_OK))
+			ret = ERROR_FAIL;
+		else if (svf_check_tdo() != ERROR_OK)
+			ret = ERROR_FAIL;
+	}
 
 	/* print time */
-	time_measure_ms = timeval_ms() - time_measure_ms;
-	time_measure_s = time_measure_ms / 1000;
-	time_measure_ms %= 1000;
-	time_measure_m = time_measure_s / 60;
-	time_measure_s %= 60;
-	if (time_measure_ms < 1000)
-		command_print(CMD,
-			"\r\nTime used: %dm%ds%" PRId64 "ms ",
-			time_measure_m,
-			time_measure_s,
-			time_measure_ms);
+	svf_print_time_used(CMD, time_measure_ms);
 
 free_all:
 
@@ -622,21 +1173,7 @@ free_all:
 	svf_command_buffer = NULL;
 	svf_command_buffer_size = 0;
 
-	free(svf_check_tdo_para);
-	svf_check_tdo_para = NULL;
-	svf_check_tdo_para_index = 0;
-
-	free(svf_tdi_buffer);
-	svf_tdi_buffer = NULL;
-
-	free(svf_tdo_buffer);
-	svf_tdo_buffer = NULL;
-
-	free(svf_mask_buffer);
-	svf_mask_buffer = NULL;
-
-	svf_buffer_index = 0;
-	svf_buffer_size = 0;
+	svf_free_run_buffers();
 
 	svf_free_xxd_para(&svf_para.hdr_para);
 	svf_free_xxd_para(&svf_para.hir_para);
@@ -645,6 +1182,18 @@ free_all:
 	svf_free_xxd_para(&svf_para.sdr_para);
 	svf_free_xxd_para(&svf_para.sir_para);
 
+	svf_free_ops();
+	svf_preparse = false;
+
+	if (svf_compile_file) {
+		if (ret == ERROR_OK)
+			command_print(CMD, "svf file compiled for %d commands", command_num);
+		else
+			command_print(CMD, "svf file compile failed");
+		svf_ignore_error = 0;
+		return ret;
+	}
+
 	if (ret == ERROR_OK)
 		command_print(CMD,
 			      "svf file programmed %s for %d commands with %d errors",
@@ -971,6 +1520,10 @@ static int svf_add_check_para(uint8_t enabled, int buffer_offset, int bit_len)
 
 static int svf_execute_tap(void)
 {
+	/* nothing is queued while the stream is being built */
+	if (svf_preparse)
+		return ERROR_OK;
+
 	if ((!svf_nil) && (jtag_execute_queue() != ERROR_OK))
 		return ERROR_FAIL;
 	else if (svf_check_tdo() != ERROR_OK)
@@ -985,7 +1538,6 @@ static int svf_xxr_common(char **argus, int num_of_argu, char command, struct sv
 {
 	int i, i_tmp;
 	uint8_t **pbuffer_tmp;
-	struct scan_field field;
 
 	/* XXR length [TDI (tdi)] [TDO (tdo)][MASK (mask)] [SMASK (smask)] */
 	if (num_of_argu > 10 || (num_of_argu % 2)) {
@@ -1151,25 +1703,15 @@ static int svf_xxr_common(char **argus, int num_of_argu, char command, struct sv
 					svf_para.tdr_para.len);
 			i += svf_para.tdr_para.len;
 
-			svf_add_check_para(1, svf_buffer_index, i);
-		} else {
-			svf_add_check_para(0, svf_buffer_index, i);
-		}
-		field.num_bits = i;
-		field.out_value = &svf_tdi_buffer[svf_buffer_index];
-		field.in_value = (xxr_para_tmp->data_mask & XXR_TDO) ? &svf_tdi_buffer[svf_buffer_index] : NULL;
-		if (!svf_nil) {
-			/* NOTE:  doesn't use SVF-specified state paths */
-			jtag_add_plain_dr_scan(field.num_bits,
-					field.out_value,
-					field.in_value,
-					svf_para.dr_end_state);
 		}
+		if (svf_add_scan(false, i, svf_para.sdr_para.data_mask & XXR_TDO,
+				svf_para.dr_end_state) != ERROR_OK)
+			return ERROR_FAIL;
 
-		if (svf_addcycles)
-			jtag_add_clocks(svf_addcycles);
-
-		svf_buffer_index += (i + 7) >> 3;
+		if (svf_addcycles) {
+			if (svf_add_clocks(svf_addcycles) != ERROR_OK)
+				return ERROR_FAIL;
+		}
 	} else if (command == SIR) {
 		/* check buffer size first, reallocate if necessary */
 		i = svf_para.hir_para.len + svf_para.sir_para.len +
@@ -1245,22 +1787,10 @@ static int svf_xxr_common(char **argus, int num_of_argu, char command, struct sv
 					svf_para.tir_para.len);
 			i += svf_para.tir_para.len;
 
-			svf_add_check_para(1, svf_buffer_index, i);
-		} else {
-			svf_add_check_para(0, svf_buffer_index, i);
-		}
-		field.num_bits = i;
-		field.out_value = &svf_tdi_buffer[svf_buffer_index];
-		field.in_value = (xxr_para_tmp->data_mask & XXR_TDO) ? &svf_tdi_buffer[svf_buffer_index] : NULL;
-		if (!svf_nil) {
-			/* NOTE:  doesn't use SVF-specified state paths */
-			jtag_add_plain_ir_scan(field.num_bits,
-					field.out_value,
-					field.in_value,
-					svf_para.ir_end_state);
 		}
-
-		svf_buffer_index += (i + 7) >> 3;
+		if (svf_add_scan(true, i, svf_para.sir_para.data_mask & XXR_TDO,
+				svf_para.ir_end_state) != ERROR_OK)
+			return ERROR_FAIL;
 	}
 
 	return ERROR_OK;
@@ -1335,9 +1865,8 @@ static int svf_run_command(struct command_context *cmd_ctx, char *cmd_str)
 			svf_para.frequency = atof(argus[1]);
 			/* TODO: set jtag speed to */
 			if (svf_para.frequency > 0) {
-				command_run_linef(cmd_ctx,
-						"adapter speed %d",
-						(int)svf_para.frequency / 1000);
+				if (svf_set_frequency(cmd_ctx, (int)svf_para.frequency / 1000) != ERROR_OK)
+					return ERROR_FAIL;
 				LOG_DEBUG("\tfrequency = %f", svf_para.frequency);
 			}
 		}
@@ -1471,18 +2000,18 @@ static int svf_run_command(struct command_context *cmd_ctx, char *cmd_str)
 			uint32_t min_usec = 1000000 * min_time;
 
 			/* enter into run_state if necessary */
-			if (cmd_queue_cur_state != svf_para.runtest_run_state)
+			if (svf_current_state() != svf_para.runtest_run_state)
 				svf_add_statemove(svf_para.runtest_run_state);
 
 			/* add clocks and/or min wait */
 			if (run_count > 0) {
-				if (!svf_nil)
-					jtag_add_clocks(run_count);
+				if (svf_add_clocks(run_count) != ERROR_OK)
+					return ERROR_FAIL;
 			}
 
 			if (min_usec > 0) {
-				if (!svf_nil)
-					jtag_add_sleep(min_usec);
+				if (svf_add_sleep(min_usec) != ERROR_OK)
+					return ERROR_FAIL;
 			}
 
 			/* move to end_state if necessary */
@@ -1531,12 +2060,14 @@ static int svf_run_command(struct command_context *cmd_ctx, char *cmd_str)
 				/* OpenOCD refuses paths containing TAP_RESET */
 				if (path[i] == TAP_RESET) {
 					/* FIXME last state MUST be stable! */
-					if (i > 0) {
-						if (!svf_nil)
-							jtag_add_pathmove(i, path);
+					if (i > 0 && svf_add_pathmove(i, path) != ERROR_OK) {
+						free(path);
+						return ERROR_FAIL;
+					}
+					if (svf_add_tlr() != ERROR_OK) {
+						free(path);
+						return ERROR_FAIL;
 					}
-					if (!svf_nil)
-						jtag_add_tlr();
 					num_of_argu -= i + 1;
 					i = -1;
 				}
@@ -1545,8 +2076,10 @@ static int svf_run_command(struct command_context *cmd_ctx, char *cmd_str)
 				/* execute last path if necessary */
 				if (svf_tap_state_is_stable(path[num_of_argu - 1])) {
 					/* last state MUST be stable state */
-					if (!svf_nil)
-						jtag_add_pathmove(num_of_argu, path);
+					if (svf_add_pathmove(num_of_argu, path) != ERROR_OK) {
+						free(path);
+						return ERROR_FAIL;
+					}
 					LOG_DEBUG("\tmove to %s by path_move",
 							tap_state_name(path[num_of_argu - 1]));
 				} else {
@@ -1589,13 +2122,13 @@ static int svf_run_command(struct command_context *cmd_ctx, char *cmd_str)
 					ARRAY_SIZE(svf_trst_mode_name));
 			switch (i_tmp) {
 			case TRST_ON:
-				if (!svf_nil)
-					jtag_add_reset(1, 0);
+				if (svf_add_trst(1) != ERROR_OK)
+					return ERROR_FAIL;
 				break;
 			case TRST_Z:
 			case TRST_OFF:
-				if (!svf_nil)
-					jtag_add_reset(0, 0);
+				if (svf_add_trst(0) != ERROR_OK)
+					return ERROR_FAIL;
 				break;
 			case TRST_ABSENT:
 				break;
@@ -1645,13 +2178,188 @@ static int svf_run_command(struct command_context *cmd_ctx, char *cmd_str)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_svf_compile_command)
+{
+	const char *output = NULL;
+	unsigned int argc = 0;
+	bool have_input = false;
+
+	if (CMD_ARGC < 2 || CMD_ARGC > SVF_MAX_NUM_OF_OPTIONS + 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	/* pass the options and the SVF file to "svf", the second file is the
+	 * output; options that make no sense without running are rejected */
+	const char **argv = calloc(CMD_ARGC, sizeof(*argv));
+	if (!argv) {
+		LOG_ERROR("not enough memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < CMD_ARGC; i++) {
+		const struct nvp *n = nvp_name2value(svf_cmd_opts, CMD_ARGV[i]);
+		switch (n->value) {
+		case OPT_ADDCYCLES:
+		case OPT_TAP:
+			if (i + 1 == CMD_ARGC)
+				goto syntax_error;
+			argv[argc++] = CMD_ARGV[i++];
+			argv[argc++] = CMD_ARGV[i];
+			break;
+		case OPT_QUIET:
+		case OPT_NORESET:
+			argv[argc++] = CMD_ARGV[i];
+			break;
+		case -1:
+			if (!have_input) {
+				argv[argc++] = CMD_ARGV[i];
+				have_input = true;
+			} else if (!output) {
+				output = CMD_ARGV[i];
+			} else {
+				goto syntax_error;
+			}
+			break;
+		default:
+			command_print(CMD, "option '%s' not supported by svf compile", CMD_ARGV[i]);
+			goto syntax_error;
+		}
+	}
+	if (!output)
+		goto syntax_error;
+
+	/* parse the SVF file like "svf -preparse" */
+	struct command_invocation svf_cmd = *CMD;
+	svf_cmd.argc = argc;
+	svf_cmd.argv = argv;
+
+	svf_compile_file = output;
+	int retval = handle_svf_command(&svf_cmd);
+	svf_compile_file = NULL;
+
+	free(argv);
+	return retval;
+
+syntax_error:
+	free(argv);
+	return ERROR_COMMAND_SYNTAX_ERROR;
+}
+
+COMMAND_HANDLER(handle_svf_replay_command)
+{
+	const char *filename = NULL;
+	enum tap_state start_state;
+	size_t op_count;
+	int ret;
+
+	svf_nil = 0;
+	svf_progress_enabled = 0;
+	svf_ignore_error = 0;
+
+	for (unsigned int i = 0; i < CMD_ARGC; i++) {
+		if (!strcmp(CMD_ARGV[i], "-progress"))
+			svf_progress_enabled = 1;
+		else if (!strcmp(CMD_ARGV[i], "-ignore_error"))
+			svf_ignore_error = 1;
+		else if (!filename)
+			filename = CMD_ARGV[i];
+		else
+			return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+	if (!filename)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int64_t time_measure_ms = timeval_ms();
+
+	ret = svf_read_compiled(filename, &start_state, &svf_total_lines);
+	if (ret != ERROR_OK) {
+		command_print(CMD, "svf file replay failed");
+		svf_ignore_error = 0;
+		return ret;
+	}
+	LOG_USER("svf replaying file: \"%s\"", filename);
+	op_count = svf_ops_count;
+
+	/* the state moves were computed for this start state */
+	if (svf_ops_count && svf_ops[0].type != SVF_OP_TLR &&
+			start_state != cmd_queue_cur_state) {
+		LOG_ERROR("\"%s\" was compiled to start in %s, TAP is in %s",
+				filename, tap_state_name(start_state),
+				tap_state_name(cmd_queue_cur_state));
+		ret = ERROR_FAIL;
+		goto free_all;
+	}
+
+	svf_check_tdo_para = malloc(sizeof(struct svf_check_tdo_para) * SVF_CHECK_TDO_PARA_SIZE);
+	if (!svf_check_tdo_para) {
+		LOG_ERROR("not enough memory");
+		ret = ERROR_FAIL;
+		goto free_all;
+	}
+
+	svf_buffer_index = 0;
+	if (svf_realloc_buffers(2 * SVF_MAX_BUFFER_SIZE_TO_COMMIT) != ERROR_OK) {
+		ret = ERROR_FAIL;
+		goto free_all;
+	}
+
+	svf_last_printed_percentage = -1;
+	if (svf_progress_enabled && svf_total_lines <= 0)
+		svf_progress_enabled = 0;
+
+	ret = svf_run_ops(CMD_CTX);
+	if (ret != ERROR_OK)
+		LOG_ERROR("fail to run command at line %d", svf_line_number);
+
+	if (jtag_execute_queue() != ERROR_OK)
+		ret = ERROR_FAIL;
+	else if (svf_check_tdo() != ERROR_OK)
+		ret = ERROR_FAIL;
+
+	svf_print_time_used(CMD, time_measure_ms);
+
+free_all:
+	svf_free_run_buffers();
+	svf_free_ops();
+
+	if (ret == ERROR_OK)
+		command_print(CMD,
+			      "svf file replayed %s for %zu operations with %d errors",
+			      (svf_ignore_error > 1) ? "unsuccessfully" : "successfully",
+			      op_count,
+			      (svf_ignore_error > 1) ? (svf_ignore_error - 1) : 0);
+	else
+		command_print(CMD, "svf file replay failed");
+
+	svf_ignore_error = 0;
+	return ret;
+}
+
+static const struct command_registration svf_subcommand_handlers[] = {
+	{
+		.name = "compile",
+		.handler = handle_svf_compile_command,
+		.mode = COMMAND_ANY,
+		.help = "Parses a SVF file into a compiled file for \"svf replay\".",
+		.usage = "file output [-tap device.tap] [-quiet] [-noreset] [-addcycles numcycles]",
+	},
+	{
+		.name = "replay",
+		.handler = handle_svf_replay_command,
+		.mode = COMMAND_EXEC,
+		.help = "Runs a file written by \"svf compile\".",
+		.usage = "[-progress] [-ignore_error] file",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration svf_command_handlers[] = {
 	{
 		.name = "svf",
 		.handler = handle_svf_command,
 		.mode = COMMAND_EXEC,
 		.help = "Runs a SVF file.",
-		.usage = "[-tap device.tap] [-quiet] [-nil] [-progress] [-ignore_error] [-noreset] [-addcycles numcycles] file",
+		.usage = "[-tap device.tap] [-quiet] [-nil] [-progress] [-ignore_error] [-noreset] [-preparse] [-addcycles numcycles] file",
+		.chain = svf_subcommand_handlers,
 	},
 	COMMAND_REGISTRATION_DONE
 };
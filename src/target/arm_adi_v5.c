@@ -596,6 +596,10 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 	return retval;
 }
 
+/* Maximum number of DRW reads queued by mem_ap_read() before the queue is run
+ * and the data is copied to the caller's buffer. */
+#define MEM_AP_READ_WINDOW (64 * 1024)
+
 /**
  * Synchronous read of a block of memory, using a specific access size.
  *
@@ -634,93 +638,112 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 
 	/* Allocate buffer to hold the sequence of DRW reads that will be made. This is a significant
 	 * over-allocation if packed transfers are going to be used, but determining the real need at
-	 * this point would be messy. */
-	uint32_t *read_buf = calloc(count, MAX(sizeof(uint32_t), size));
+	 * this point would be messy. Large reads are done in windows of MEM_AP_READ_WINDOW DRW reads,
+	 * so the buffer (and the adapter's queue) doesn't grow with the size of the read. */
+	const size_t max_drw_ops = (size_t)count * MAX(sizeof(uint32_t), size) / sizeof(uint32_t);
+	const size_t window_ops = MIN(max_drw_ops, MEM_AP_READ_WINDOW);
+	uint32_t *read_buf = calloc(window_ops, sizeof(uint32_t));
 
-	/* Multiplication count * sizeof(uint32_t) may overflow, calloc() is safe */
-	uint32_t *read_ptr = read_buf;
 	if (!read_buf) {
 		LOG_ERROR("Failed to allocate read buffer");
 		return ERROR_FAIL;
 	}
 
-	/* Queue up all reads. Each read will store the entire DRW word in the read buffer. How many
-	 * useful bytes it contains, and their location in the word, depends on the type of transfer
-	 * and alignment. */
-	while (nbytes > 0) {
-		unsigned int this_size;
-		retval = mem_ap_setup_transfer_verify_size_packing_fallback(ap,
-					size, address,
-					addrinc, nbytes >= 4, &this_size);
-		if (retval != ERROR_OK)
-			break;
-
+	target_addr_t ti_be_lane_xor = dap->ti_be_32_quirks ? 3 : 0;
 
-		unsigned int drw_ops = DIV_ROUND_UP(this_size, 4);
-		while (drw_ops--) {
-			retval = dap_queue_ap_read(ap, MEM_AP_REG_DRW(dap), read_ptr++);
+	/* Address and number of the bytes not yet copied to the caller's buffer */
+	target_addr_t replay_address = adr;
+	size_t replay_nbytes = nbytes;
+
+	while (nbytes > 0 && retval == ERROR_OK) {
+		uint32_t *read_ptr = read_buf;
+		const target_addr_t window_address = address;
+		size_t window_nbytes = 0;
+
+		/* Queue up the reads of this window. Each read will store the entire DRW word in the
+		 * read buffer. How many useful bytes it contains, and their location in the word,
+		 * depends on the type of transfer and alignment. */
+		while (nbytes > 0 && (size_t)(read_ptr - read_buf) + MAX(size, 4) / 4 <= window_ops) {
+			unsigned int this_size;
+			retval = mem_ap_setup_transfer_verify_size_packing_fallback(ap,
+						size, address,
+						addrinc, nbytes >= 4, &this_size);
 			if (retval != ERROR_OK)
 				break;
-		}
 
-		nbytes -= this_size;
-		if (addrinc)
-			address += this_size;
 
-		mem_ap_update_tar_cache(ap);
-	}
+			unsigned int drw_ops = DIV_ROUND_UP(this_size, 4);
+			while (drw_ops--) {
+				retval = dap_queue_ap_read(ap, MEM_AP_REG_DRW(dap), read_ptr++);
+				if (retval != ERROR_OK)
+					break;
+			}
 
-	if (retval == ERROR_OK)
-		retval = dap_run(dap);
+			nbytes -= this_size;
+			window_nbytes += this_size;
+			if (addrinc)
+				address += this_size;
 
-	/* Restore state */
-	address = adr;
-	nbytes = size * count;
-	read_ptr = read_buf;
+			mem_ap_update_tar_cache(ap);
+		}
 
-	/* If something failed, read TAR to find out how much data was successfully read, so we can
-	 * at least give the caller what we have. */
-	if (retval == ERROR_TARGET_SIZE_NOT_SUPPORTED) {
-		nbytes = 0;
-	} else if (retval != ERROR_OK) {
-		target_addr_t tar;
-		if (mem_ap_read_tar(ap, &tar) == ERROR_OK) {
-			/* TAR is incremented after failed transfer on some devices (eg Cortex-M4) */
-			LOG_ERROR("Failed to read memory at " TARGET_ADDR_FMT, tar);
-			if (nbytes > tar - address)
-				nbytes = tar - address;
-		} else {
-			LOG_ERROR("Failed to read memory and, additionally, failed to find out where");
-			nbytes = 0;
+		if (retval == ERROR_OK)
+			retval = dap_run(dap);
+
+		/* If something failed, read TAR to find out how much data was successfully read, so we
+		 * can at least give the caller what we have. */
+		size_t copy_nbytes = window_nbytes;
+		if (retval == ERROR_TARGET_SIZE_NOT_SUPPORTED) {
+			copy_nbytes = 0;
+		} else if (retval != ERROR_OK) {
+			target_addr_t tar;
+			if (mem_ap_read_tar(ap, &tar) == ERROR_OK) {
+				/* TAR is incremented after failed transfer on some devices (eg Cortex-M4) */
+				LOG_ERROR("Failed to read memory at " TARGET_ADDR_FMT, tar);
+				if (copy_nbytes > tar - window_address)
+					copy_nbytes = tar - window_address;
+			} else {
+				LOG_ERROR("Failed to read memory and, additionally, failed to find out where");
+				copy_nbytes = 0;
+			}
 		}
-	}
 
-	target_addr_t ti_be_lane_xor = dap->ti_be_32_quirks ? 3 : 0;
+		/* Replay loop to populate caller's buffer from the correct word and byte lane */
+		read_ptr = read_buf;
+		while (copy_nbytes > 0) {
+			/* Convert transfers longer than 32-bit on word-at-a-time basis */
+			unsigned int this_size = MIN(size, 4);
 
-	/* Replay loop to populate caller's buffer from the correct word and byte lane */
-	while (nbytes > 0) {
-		/* Convert transfers longer than 32-bit on word-at-a-time basis */
-		unsigned int this_size = MIN(size, 4);
+			if (size < 4 && addrinc && ap->packed_transfers_supported && replay_nbytes >= 4
+					&& max_tar_block_size(ap->tar_autoincr_block, replay_address) >= 4) {
+				this_size = 4;	/* Packed read of 4 bytes or 2 halfwords */
+			}
+			if (this_size > copy_nbytes)
+				break;
 
-		if (size < 4 && addrinc && ap->packed_transfers_supported && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
-			this_size = 4;	/* Packed read of 4 bytes or 2 halfwords */
-		}
+			if (this_size == 4 && !ti_be_lane_xor && (replay_address & 3) == 0) {
+				/* Plain little-endian word */
+				h_u32_to_le(buffer, *read_ptr);
+				buffer += 4;
+				replay_address += 4;
+			} else {
+				switch (this_size) {
+				case 4:
+					*buffer++ = *read_ptr >> 8 * ((replay_address++ & 3) ^ ti_be_lane_xor);
+					*buffer++ = *read_ptr >> 8 * ((replay_address++ & 3) ^ ti_be_lane_xor);
+					/* fallthrough */
+				case 2:
+					*buffer++ = *read_ptr >> 8 * ((replay_address++ & 3) ^ ti_be_lane_xor);
+					/* fallthrough */
+				case 1:
+					*buffer++ = *read_ptr >> 8 * ((replay_address++ & 3) ^ ti_be_lane_xor);
+				}
+			}
 
-		switch (this_size) {
-		case 4:
-			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
-			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
-			/* fallthrough */
-		case 2:
-			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
-			/* fallthrough */
-		case 1:
-			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
+			read_ptr++;
+			copy_nbytes -= this_size;
+			replay_nbytes -= this_size;
 		}
-
-		read_ptr++;
-		nbytes -= this_size;
 	}
 
 	free(read_buf);
@@ -23,6 +23,7 @@
 
 #include "image.h"
 #include "target.h"
+#include <helper/crc32.h>
 #include <helper/log.h>
 #include <server/server.h>
 
@@ -1170,6 +1171,110 @@ int image_read_section(struct image *image,
 	return ERROR_OK;
 }
 
+static int image_section_map(struct image *image, int section,
+	target_addr_t offset, uint32_t size, const uint8_t **data)
+{
+	const uint8_t *map;
+	size_t filesize;
+	uint64_t file_offset;
+	struct fileio *fileio;
+	int retval;
+
+	if (image->type == IMAGE_IHEX || image->type == IMAGE_SRECORD
+			|| image->type == IMAGE_BUILDER) {
+		/* already buffered in memory */
+		*data = (const uint8_t *)image->sections[section].private + offset;
+		return ERROR_OK;
+	} else if (image->type == IMAGE_BINARY) {
+		struct image_binary *image_binary = image->type_private;
+
+		fileio = image_binary->fileio;
+		file_offset = offset;
+	} else if (image->type == IMAGE_ELF) {
+		struct image_elf *elf = image->type_private;
+
+		fileio = elf->fileio;
+		if (elf->is_64_bit) {
+			Elf64_Phdr *segment = image->sections[section].private;
+			file_offset = field64(elf, segment->p_offset) + offset;
+		} else {
+			Elf32_Phdr *segment = image->sections[section].private;
+			file_offset = field32(elf, segment->p_offset) + offset;
+		}
+	} else {
+		return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+	}
+
+	retval = fileio_size(fileio, &filesize);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* a truncated file is handled by the regular read path */
+	if (file_offset + size > filesize)
+		return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+
+	retval = fileio_map(fileio, &map);
+	if (retval != ERROR_OK)
+		return retval;
+
+	*data = map + file_offset;
+	return ERROR_OK;
+}
+
+/**
+ * Get a pointer to the content of a section without copying it when
+ * possible: binary and ELF images are mapped in memory, IHEX, S-record
+ * and builder images are already buffered.
+ * Otherwise the content is read in a buffer allocated here.
+ * When no buffer was allocated the content is shared with the image and
+ * must not be modified; callers that may modify it have to copy it.
+ *
+ * @param data on success, points to the requested content
+ * @param buffer on success, the buffer allocated to hold the content or
+ * NULL if none was needed; to be released by the caller with free()
+ */
+int image_section_data(struct image *image, int section, target_addr_t offset,
+	uint32_t size, const uint8_t **data, uint8_t **buffer, size_t *size_read)
+{
+	int retval;
+
+	*buffer = NULL;
+
+	/* don't read past the end of a section */
+	if (offset + size > image->sections[section].size) {
+		LOG_DEBUG(
+			"read past end of section: 0x%8.8" TARGET_PRIxADDR " + 0x%8.8" PRIx32 " > 0x%8.8" PRIx32,
+			offset,
+			size,
+			image->sections[section].size);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	retval = image_section_map(image, section, offset, size, data);
+	if (retval == ERROR_OK) {
+		*size_read = size;
+		return ERROR_OK;
+	}
+	if (retval != ERROR_FILEIO_OPERATION_NOT_SUPPORTED)
+		return retval;
+
+	*buffer = malloc(size);
+	if (!*buffer) {
+		LOG_ERROR("error allocating buffer for section (%" PRIu32 " bytes)", size);
+		return ERROR_FAIL;
+	}
+
+	retval = image_read_section(image, section, offset, size, *buffer, size_read);
+	if (retval != ERROR_OK) {
+		free(*buffer);
+		*buffer = NULL;
+		return retval;
+	}
+
+	*data = *buffer;
+	return ERROR_OK;
+}
+
 int image_add_section(struct image *image, target_addr_t base, uint32_t size, uint64_t flags, uint8_t const *data)
 {
 	struct imagesection *section;
@@ -1269,31 +1374,14 @@ int image_calculate_checksum(const uint8_t *buffer, uint32_t nbytes, uint32_t *c
 	uint32_t crc = 0xffffffff;
 	LOG_DEBUG("Calculating checksum");
 
-	static uint32_t crc32_table[256];
-
-	static bool first_init;
-	if (!first_init) {
-		/* Initialize the CRC table and the decoding table.  */
-		unsigned int i, j, c;
-		for (i = 0; i < 256; i++) {
-			/* as per gdb */
-			for (c = i << 24, j = 8; j > 0; --j)
-				c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
-			crc32_table[i] = c;
-		}
-
-		first_init = true;
-	}
-
 	while (nbytes > 0) {
 		int run = nbytes;
 		if (run > 32768)
 			run = 32768;
 		nbytes -= run;
-		while (run--) {
-			/* as per gdb */
-			crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ *buffer++) & 255];
-		}
+		/* as per gdb */
+		crc = crc32_be(CRC32_POLY_BE, crc, buffer, run);
+		buffer += run;
 		keep_alive();
 		if (openocd_is_shutdown_pending())
 			return ERROR_SERVER_INTERRUPTED;
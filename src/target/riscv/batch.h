@@ -120,6 +120,21 @@ static inline int riscv_scan_increase_delay(struct riscv_scan_delays *delays,
 	return ERROR_OK;
 }
 
+/* Lower the delay specific to the class (not the base delay it is added to)
+ * by about 10%. Returns false if it is already 0.
+ */
+static inline bool riscv_scan_decrease_delay(struct riscv_scan_delays *delays,
+		enum riscv_scan_delay_class delay_class)
+{
+	unsigned int delay = riscv_scan_get_delay(delays, delay_class);
+	if (delay_class != RISCV_DELAY_BASE)
+		delay -= delays->base_delay;
+	if (delay == 0)
+		return false;
+	riscv_scan_set_delay(delays, delay_class, delay - (delay / 10 + 1));
+	return true;
+}
+
 /* A batch of multiple JTAG scans, which are grouped together to avoid the
  * overhead of some JTAG adapters when sending single commands.  This is
  * designed to support block copies, as that's what we actually need to go
@@ -18,9 +18,11 @@
 #include "target/target_type.h"
 #include <helper/align.h>
 #include <helper/log.h>
+#include "jtag/adapter.h"
 #include "jtag/jtag.h"
 #include "target/register.h"
 #include "target/breakpoints.h"
+#include "target/smp.h"
 #include "helper/time_support.h"
 #include "helper/list.h"
 #include "riscv.h"
@@ -43,6 +45,8 @@ static int riscv013_clear_abstract_error(struct target *target);
 static int dm013_select_hart(struct target *target, int hart_index);
 static int riscv013_halt_prep(struct target *target);
 static int riscv013_halt_go(struct target *target);
+static int riscv013_sample_hart_states(struct target *target,
+		struct list_head *targets);
 static int riscv013_resume_go(struct target *target);
 static int riscv013_step_current_hart(struct target *target);
 static int riscv013_on_step(struct target *target);
@@ -127,6 +131,8 @@ typedef struct {
 	int current_hartid;
 
 	bool hasel_supported;
+	/* Scratch flag used by riscv013_sample_hart_states(). */
+	bool hart_states_sampled;
 
 	/* The program buffer stores executable code. 0 is an illegal instruction,
 	 * so we use 0 to mean the cached value is invalid. */
@@ -199,6 +205,30 @@ static bool ac_cache_contains(const struct ac_cache *cache, uint32_t command)
 			sizeof(*cache->commands), ac_cache_elem_comparator);
 }
 
+/* Number of busy free scans of a delay class after which a lower delay is
+ * tried. The interval doubles every time such a probe hits a busy response,
+ * so a delay which is really needed is not probed too often.
+ */
+#define DELAY_PROBE_MIN_SCANS	1000
+#define DELAY_PROBE_MAX_SCANS	(DELAY_PROBE_MIN_SCANS << 10)
+
+#define RISCV_DELAY_CLASS_COUNT	(RISCV_DELAY_SYSBUS_WRITE + 1)
+
+/* Adaptive tuning state and statistics of a "riscv_scan_delay_class" */
+struct delay_class_stats {
+	/* Scans since the last busy response or change of the delay. */
+	uint64_t busy_free_scans;
+	/* Busy free scans needed before trying a lower delay. */
+	uint64_t probe_after;
+	/* The delay was lowered and no busy response was seen since. */
+	bool probing;
+
+	uint64_t scans;
+	uint64_t busy;
+	uint64_t idle_cycles;
+	unsigned int decreases;
+};
+
 typedef struct {
 	/* The indexed used to address this hart in its DM. */
 	unsigned int index;
@@ -228,6 +258,8 @@ typedef struct {
 	 * response.
 	 */
 	struct riscv_scan_delays learned_delays;
+	/* Lower delays are tried after long enough runs without busy. */
+	struct delay_class_stats delay_stats[RISCV_DELAY_CLASS_COUNT];
 
 	struct ac_cache ac_not_supported_cache;
 
@@ -432,16 +464,63 @@ static void select_dmi(struct jtag_tap *tap)
 		jtag_add_ir_scan(tap, &select_dbus, TAP_IDLE);
 }
 
-static int increase_dmi_busy_delay(struct target *target)
+/* Called on every busy response for a delay class. */
+static int increase_learned_delay(struct target *target,
+		enum riscv_scan_delay_class delay_class)
 {
 	RISCV013_INFO(info);
+	struct delay_class_stats *stats = &info->delay_stats[delay_class];
+
+	stats->busy++;
+	stats->busy_free_scans = 0;
+	if (stats->probing) {
+		/* The lower delay is too low, wait longer before the next try. */
+		stats->probing = false;
+		stats->probe_after = MIN(2 * stats->probe_after, DELAY_PROBE_MAX_SCANS);
+	}
+
+	return riscv_scan_increase_delay(&info->learned_delays, delay_class);
+}
+
+/* Account the scans of a batch which completed without busy response and
+ * try lower delays for the classes which have not seen busy for long. */
+static void note_busy_free_batch(struct target *target, const struct riscv_batch *batch)
+{
+	RISCV013_INFO(info);
+
+	for (size_t i = 0; i < batch->used_scans; i++) {
+		const enum riscv_scan_delay_class delay_class = batch->delay_classes[i];
+		struct delay_class_stats *stats = &info->delay_stats[delay_class];
+
+		stats->scans++;
+		stats->busy_free_scans++;
+		stats->idle_cycles += riscv_scan_get_delay(&info->learned_delays, delay_class);
+	}
+
+	for (unsigned int c = 0; c < RISCV_DELAY_CLASS_COUNT; c++) {
+		struct delay_class_stats *stats = &info->delay_stats[c];
 
+		if (stats->busy_free_scans < stats->probe_after)
+			continue;
+
+		if (stats->probing)
+			/* The previous lower delay works, probe at the fast pace again. */
+			stats->probe_after = DELAY_PROBE_MIN_SCANS;
+		stats->busy_free_scans = 0;
+		stats->probing = riscv_scan_decrease_delay(&info->learned_delays, c);
+		if (stats->probing)
+			stats->decreases++;
+	}
+}
+
+static int increase_dmi_busy_delay(struct target *target)
+{
 	int res = dtmcs_scan(target->tap, DTM_DTMCS_DMIRESET,
 			NULL /* discard result */);
 	if (res != ERROR_OK)
 		return res;
 
-	return riscv_scan_increase_delay(&info->learned_delays, RISCV_DELAY_BASE);
+	return increase_learned_delay(target, RISCV_DELAY_BASE);
 }
 
 static void reset_learned_delays(struct target *target)
@@ -449,6 +528,131 @@ static void reset_learned_delays(struct target *target)
 	RISCV013_INFO(info);
 	assert(info);
 	memset(&info->learned_delays, 0, sizeof(info->learned_delays));
+	for (unsigned int c = 0; c < RISCV_DELAY_CLASS_COUNT; c++) {
+		info->delay_stats[c].busy_free_scans = 0;
+		info->delay_stats[c].probe_after = DELAY_PROBE_MIN_SCANS;
+		info->delay_stats[c].probing = false;
+	}
+}
+
+/* The delay profile is a text file with one line per target:
+ * "<target name> <base> <abstract command> <sysbus read> <sysbus write>".
+ */
+static void load_delay_profile(struct target *target)
+{
+	RISCV_INFO(r);
+	RISCV013_INFO(info);
+
+	if (!r->delay_profile)
+		return;
+
+	FILE *f = fopen(r->delay_profile, "r");
+	if (!f) {
+		LOG_TARGET_DEBUG(target, "No delay profile in %s.", r->delay_profile);
+		return;
+	}
+
+	char line[256];
+	char name[128];
+	unsigned int base, ac, sb_read, sb_write;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%127s %u %u %u %u", name, &base, &ac, &sb_read, &sb_write) != 5)
+			continue;
+		if (strcmp(name, target_name(target)))
+			continue;
+		if (base > RISCV_SCAN_DELAY_MAX || ac > RISCV_SCAN_DELAY_MAX
+				|| sb_read > RISCV_SCAN_DELAY_MAX || sb_write > RISCV_SCAN_DELAY_MAX) {
+			LOG_TARGET_WARNING(target, "Ignoring invalid delays in %s.", r->delay_profile);
+			break;
+		}
+		riscv_scan_set_delay(&info->learned_delays, RISCV_DELAY_BASE, base);
+		riscv_scan_set_delay(&info->learned_delays, RISCV_DELAY_ABSTRACT_COMMAND, ac);
+		riscv_scan_set_delay(&info->learned_delays, RISCV_DELAY_SYSBUS_READ, sb_read);
+		riscv_scan_set_delay(&info->learned_delays, RISCV_DELAY_SYSBUS_WRITE, sb_write);
+		LOG_TARGET_INFO(target, "Loaded delays from %s.", r->delay_profile);
+		break;
+	}
+
+	fclose(f);
+}
+
+static void save_delay_profile(struct target *target)
+{
+	RISCV_INFO(r);
+	RISCV013_INFO(info);
+
+	if (!r->delay_profile)
+		return;
+
+	/* keep the lines of the other targets */
+	char *others = NULL;
+	size_t others_len = 0;
+	FILE *f = fopen(r->delay_profile, "r");
+	if (f) {
+		char line[256];
+		char name[128];
+		while (fgets(line, sizeof(line), f)) {
+			if (sscanf(line, "%127s", name) == 1 && !strcmp(name, target_name(target)))
+				continue;
+			size_t len = strlen(line);
+			char *tmp = realloc(others, others_len + len + 1);
+			if (!tmp)
+				break;
+			others = tmp;
+			memcpy(others + others_len, line, len + 1);
+			others_len += len;
+		}
+		fclose(f);
+	}
+
+	f = fopen(r->delay_profile, "w");
+	if (!f) {
+		LOG_TARGET_ERROR(target, "Can't write delay profile %s.", r->delay_profile);
+		free(others);
+		return;
+	}
+
+	if (others)
+		fputs(others, f);
+	const struct riscv_scan_delays *delays = &info->learned_delays;
+	fprintf(f, "%s %u %u %u %u\n", target_name(target), delays->base_delay,
+			delays->ac_delay, delays->sb_read_delay, delays->sb_write_delay);
+	fclose(f);
+	free(others);
+}
+
+static COMMAND_HELPER(riscv013_print_delay_stats, struct target *target, bool reset)
+{
+	RISCV013_INFO(info);
+
+	if (reset) {
+		for (unsigned int c = 0; c < RISCV_DELAY_CLASS_COUNT; c++) {
+			struct delay_class_stats *stats = &info->delay_stats[c];
+			stats->scans = 0;
+			stats->busy = 0;
+			stats->idle_cycles = 0;
+			stats->decreases = 0;
+		}
+		return ERROR_OK;
+	}
+
+	unsigned int khz = adapter_get_speed_khz();
+	for (unsigned int c = 0; c < RISCV_DELAY_CLASS_COUNT; c++) {
+		const struct delay_class_stats *stats = &info->delay_stats[c];
+		command_print(CMD, "%s:", riscv_scan_delay_class_name(c));
+		command_print(CMD, "  delay:       %u", riscv_scan_get_delay(&info->learned_delays, c));
+		command_print(CMD, "  scans:       %" PRIu64, stats->scans);
+		command_print(CMD, "  busy:        %" PRIu64 " (%.3f%%)", stats->busy,
+				stats->scans ? 100.0 * stats->busy / stats->scans : 0.0);
+		command_print(CMD, "  decreases:   %u", stats->decreases);
+		if (khz)
+			command_print(CMD, "  idle cycles: %" PRIu64 " (%.3fs)", stats->idle_cycles,
+					stats->idle_cycles / (1000.0 * khz));
+		else
+			command_print(CMD, "  idle cycles: %" PRIu64, stats->idle_cycles);
+	}
+
+	return ERROR_OK;
 }
 
 static void decrement_reset_delays_counter(struct target *target, size_t finished_scans)
@@ -615,9 +819,7 @@ static int dmstatus_read(struct target *target, uint32_t *dmstatus,
 
 static int increase_ac_busy_delay(struct target *target)
 {
-	riscv013_info_t *info = get_info(target);
-	return riscv_scan_increase_delay(&info->learned_delays,
-			RISCV_DELAY_ABSTRACT_COMMAND);
+	return increase_learned_delay(target, RISCV_DELAY_ABSTRACT_COMMAND);
 }
 
 static uint32_t __attribute__((unused)) abstract_register_size(unsigned int width)
@@ -823,8 +1025,12 @@ static void abstract_data_read_fill_batch(struct riscv_batch *batch, unsigned in
 	}
 }
 
+/**
+ * Get the value queued by "abstract_data_read_fill_batch()" from the batch.
+ * "first_key" is the read key of the first data register read.
+ */
 static riscv_reg_t abstract_data_get_from_batch(struct riscv_batch *batch,
-		unsigned int index, unsigned int size_bits)
+		size_t first_key, unsigned int size_bits)
 {
 	assert(size_bits >= 32);
 	assert(size_bits % 32 == 0);
@@ -832,7 +1038,7 @@ static riscv_reg_t abstract_data_get_from_batch(struct riscv_batch *batch,
 	assert(size_in_words * sizeof(uint32_t) <= sizeof(riscv_reg_t));
 	riscv_reg_t value = 0;
 	for (unsigned int i = 0; i < size_in_words; ++i) {
-		const uint32_t v = riscv_batch_get_dmi_read_data(batch, i);
+		const uint32_t v = riscv_batch_get_dmi_read_data(batch, first_key + i);
 		value |= ((riscv_reg_t)v) << (i * 32);
 	}
 	return value;
@@ -849,7 +1055,7 @@ static int read_abstract_arg(struct target *target, riscv_reg_t *value,
 	abstract_data_read_fill_batch(batch, index, size_bits);
 	int result = batch_run_timeout(target, batch);
 	if (result == ERROR_OK)
-		*value = abstract_data_get_from_batch(batch, index, size_bits);
+		*value = abstract_data_get_from_batch(batch, /*first_key*/ 0, size_bits);
 	riscv_batch_free(batch);
 	return result;
 }
@@ -955,6 +1161,111 @@ static bool is_command_unsupported(struct target *target, uint32_t command)
 	return true;
 }
 
+/* Scans needed to read one register of up to 64 bits with an abstract
+ * command: command, abstractcs and the data registers. */
+#define REGISTER_READ_BATCH_SIZE (ABSTRACT_COMMAND_BATCH_SIZE + 2)
+
+/**
+ * Read "count" registers of "size" bits with abstract commands, queueing all
+ * of them into a single batch, so the whole sequence costs one JTAG queue
+ * flush instead of two per register.
+ *
+ * On return, "*read" is the number of leading registers whose values were
+ * stored in "values". If it is less than "count" and ERROR_OK is returned,
+ * the abstract command for "numbers[*read]" did not complete in time and
+ * the remaining registers should be read one by one. Any other result means
+ * that "numbers[*read]" could not be read with an abstract command.
+ */
+static int register_read_abstract_batch(struct target *target,
+		riscv_reg_t *values, const enum gdb_regno *numbers,
+		unsigned int count, unsigned int size, unsigned int *read)
+{
+	assert(size <= 64);
+	*read = 0;
+
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+
+	struct riscv_batch *batch = riscv_batch_alloc(target,
+			count * REGISTER_READ_BATCH_SIZE);
+	size_t *abstractcs_read_keys = malloc(count * sizeof(*abstractcs_read_keys));
+	if (!batch || !abstractcs_read_keys) {
+		LOG_ERROR("Out of memory");
+		free(abstractcs_read_keys);
+		if (batch)
+			riscv_batch_free(batch);
+		return ERROR_FAIL;
+	}
+
+	int res = ERROR_OK;
+	unsigned int queued = 0;
+	for (; queued < count; ++queued) {
+		/* The spec doesn't define abstract register numbers for vector registers. */
+		if (numbers[queued] >= GDB_REGNO_V0 && numbers[queued] <= GDB_REGNO_V31)
+			break;
+		const uint32_t command = riscv013_access_register_command(target,
+				numbers[queued], size, AC_ACCESS_REGISTER_TRANSFER);
+		if (is_command_unsupported(target, command))
+			break;
+		abstractcs_read_keys[queued] = abstract_cmd_fill_batch(batch, command);
+		abstract_data_read_fill_batch(batch, /*index*/ 0, size);
+	}
+	if (queued == 0) {
+		res = ERROR_FAIL;
+		goto cleanup;
+	}
+
+	/* Abstract commands are executed while running the batch. */
+	dm->abstract_cmd_maybe_busy = true;
+
+	res = batch_run_timeout(target, batch);
+	if (res != ERROR_OK)
+		goto cleanup;
+
+	unsigned int i;
+	for (i = 0; i < queued; ++i) {
+		const uint32_t abstractcs = riscv_batch_get_dmi_read_data(batch,
+				abstractcs_read_keys[i]);
+		if (get_field32(abstractcs, DM_ABSTRACTCS_BUSY) ||
+				get_field32(abstractcs, DM_ABSTRACTCS_CMDERR) != CMDERR_NONE)
+			break;
+		values[i] = abstract_data_get_from_batch(batch,
+				abstractcs_read_keys[i] + 1, size);
+	}
+	*read = i;
+
+	if (i == queued) {
+		dm->abstract_cmd_maybe_busy = false;
+		if (queued < count)
+			res = ERROR_FAIL;
+		goto cleanup;
+	}
+
+	/* Wait for the command to finish, learn the delay and clear cmderr.
+	 * The commands and data reads queued after a busy command were
+	 * discarded by the debug module, so a busy command is not an error:
+	 * the caller reads the remaining registers again. */
+	const uint32_t abstractcs = riscv_batch_get_dmi_read_data(batch,
+			abstractcs_read_keys[i]);
+	uint32_t cmderr;
+	res = abstract_cmd_batch_check_and_clear_cmderr(target, batch,
+			abstractcs_read_keys[i], &cmderr);
+	if (res != ERROR_OK && cmderr == CMDERR_NOT_SUPPORTED) {
+		mark_command_as_unsupported(target,
+				riscv013_access_register_command(target, numbers[i], size,
+					AC_ACCESS_REGISTER_TRANSFER));
+	} else if (get_field32(abstractcs, DM_ABSTRACTCS_BUSY) &&
+			(res == ERROR_OK || cmderr == CMDERR_BUSY)) {
+		res = ERROR_OK;
+	}
+
+cleanup:
+	free(abstractcs_read_keys);
+	riscv_batch_free(batch);
+	return res;
+}
+
 static int register_read_abstract_with_size(struct target *target,
 		riscv_reg_t *value, enum gdb_regno number, unsigned int size)
 {
@@ -967,6 +1278,15 @@ static int register_read_abstract_with_size(struct target *target,
 	if (is_command_unsupported(target, command))
 		return ERROR_FAIL;
 
+	if (value && size <= 64) {
+		/* Execute the command and fetch the result in one go. */
+		unsigned int read;
+		int result = register_read_abstract_batch(target, value, &number,
+				/*count*/ 1, size, &read);
+		if (result != ERROR_OK || read == 1)
+			return result;
+	}
+
 	uint32_t cmderr;
 	int result = riscv013_execute_abstract_command(target, command, &cmderr);
 	if (result != ERROR_OK)
@@ -1823,8 +2143,10 @@ static void deinit_target(struct target *target)
 		return;
 
 	riscv013_info_t *vsinfo = info->version_specific;
-	if (vsinfo)
+	if (vsinfo) {
 		ac_cache_free(&vsinfo->ac_not_supported_cache);
+		save_delay_profile(target);
+	}
 
 	riscv013_dm_free(target);
 
@@ -2575,6 +2897,7 @@ static int batch_run(struct target *target, struct riscv_batch *batch)
 	decrement_reset_delays_counter(target, finished_scans);
 	if (riscv_batch_was_batch_busy(batch))
 		return increase_dmi_busy_delay(target);
+	note_busy_free_batch(target, batch);
 	return ERROR_OK;
 }
 
@@ -2606,6 +2929,7 @@ static int batch_run_timeout(struct target *target, struct riscv_batch *batch)
 		finished_scans = new_finished_scans;
 		if (!riscv_batch_was_batch_busy(batch)) {
 			assert(finished_scans == batch->used_scans);
+			note_busy_free_batch(target, batch);
 			return ERROR_OK;
 		}
 		result = increase_dmi_busy_delay(target);
@@ -2773,8 +3097,7 @@ static int sample_memory_bus_v1(struct target *target,
 			/* Discard this batch when we encounter "busy error" state on the System Bus level.
 			 * We'll try next time with a larger System Bus read delay. */
 			dm_write(target, DM_SBCS, sbcs_read | DM_SBCS_SBBUSYERROR | DM_SBCS_SBERROR);
-			int res = riscv_scan_increase_delay(&info->learned_delays,
-					RISCV_DELAY_SYSBUS_READ);
+			int res = increase_learned_delay(target, RISCV_DELAY_SYSBUS_READ);
 			riscv_batch_free(batch);
 			if (res != ERROR_OK)
 				return res;
@@ -2905,6 +3228,7 @@ static int init_target(struct command_context *cmd_ctx,
 
 	generic_info->select_target = &dm013_select_target;
 	generic_info->get_hart_state = &riscv013_get_hart_state;
+	generic_info->sample_hart_states = &riscv013_sample_hart_states;
 	generic_info->resume_go = &riscv013_resume_go;
 	generic_info->step_current_hart = &riscv013_step_current_hart;
 	generic_info->resume_prep = &riscv013_resume_prep;
@@ -2928,6 +3252,7 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->access_memory = &riscv013_access_memory;
 	generic_info->data_bits = &riscv013_data_bits;
 	generic_info->print_info = &riscv013_print_info;
+	generic_info->print_delay_stats = &riscv013_print_delay_stats;
 	generic_info->get_impebreak = &riscv013_get_impebreak;
 	generic_info->get_progbufsize = &riscv013_get_progbufsize;
 
@@ -2944,6 +3269,7 @@ static int init_target(struct command_context *cmd_ctx,
 
 	info->progbufsize = -1;
 	reset_learned_delays(target);
+	load_delay_profile(target);
 
 	info->ac_not_supported_cache = ac_cache_construct();
 
@@ -3417,13 +3743,9 @@ static int read_memory_bus_v1(struct target *target, const struct riscv_mem_acce
 	if (!dm)
 		return ERROR_FAIL;
 
-	RISCV013_INFO(info);
 	target_addr_t next_address = address;
 	target_addr_t end_address = address + (increment ? count : 1) * size;
 
-	/* TODO: Reading all the elements in a single batch will boost the
-	 * performance.
-	 */
 	while (next_address < end_address) {
 		uint32_t sbcs_write = set_field(0, DM_SBCS_SBREADONADDR, 1);
 		sbcs_write |= sb_sbaccess(size);
@@ -3448,17 +3770,31 @@ static int read_memory_bus_v1(struct target *target, const struct riscv_mem_acce
 		 * be unnecessary.
 		 */
 		uint32_t sbvalue[4] = {0};
-		for (uint32_t i = (next_address - address) / size; i < count - 1; i++) {
-			const uint32_t size_in_words = DIV_ROUND_UP(size, 4);
-			struct riscv_batch *batch = riscv_batch_alloc(target, size_in_words);
-			/* Read of sbdata0 must be performed as last because it
-			 * starts the new bus data transfer
-			 * (in case "sbcs.sbreadondata" was set above).
-			 * We don't want to start the next bus read before we
-			 * fetch all the data from the last bus read. */
-			for (uint32_t j = size_in_words - 1; j > 0; --j)
-				riscv_batch_add_dm_read(batch, sbdata[j], RISCV_DELAY_BASE);
-			riscv_batch_add_dm_read(batch, sbdata[0], RISCV_DELAY_SYSBUS_READ);
+		const uint32_t size_in_words = DIV_ROUND_UP(size, 4);
+		uint32_t i = (next_address - address) / size;
+		while (i < count - 1) {
+			/* Stream as many elements as fit into one batch, so that a
+			 * single JTAG queue flush covers all of them. */
+			struct riscv_batch *batch = riscv_batch_alloc(target, RISCV_BATCH_ALLOC_SIZE);
+			if (!batch)
+				return ERROR_FAIL;
+			const uint32_t batch_start = i;
+			/* Keep one scan for the sbcs read below. */
+			for (; i < count - 1 &&
+					riscv_batch_available_scans(batch) > size_in_words; i++) {
+				/* Read of sbdata0 must be performed as last because it
+				 * starts the new bus data transfer
+				 * (in case "sbcs.sbreadondata" was set above).
+				 * We don't want to start the next bus read before we
+				 * fetch all the data from the last bus read. */
+				for (uint32_t j = size_in_words - 1; j > 0; --j)
+					riscv_batch_add_dm_read(batch, sbdata[j], RISCV_DELAY_BASE);
+				riscv_batch_add_dm_read(batch, sbdata[0], RISCV_DELAY_SYSBUS_READ);
+			}
+			/* Reading sbcs doesn't start a bus access. It tells whether
+			 * the data above is valid. */
+			const size_t sbcs_key = riscv_batch_add_dm_read(batch, DM_SBCS,
+					RISCV_DELAY_BASE);
 
 			int res = batch_run_timeout(target, batch);
 			if (res != ERROR_OK) {
@@ -3466,15 +3802,24 @@ static int read_memory_bus_v1(struct target *target, const struct riscv_mem_acce
 				return res;
 			}
 
-			const size_t last_key = batch->read_keys_used - 1;
-			for (size_t k = 0; k <= last_key; ++k) {
-				sbvalue[k] = riscv_batch_get_dmi_read_data(batch, last_key - k);
-				buf_set_u32(buffer + i * size + k * 4, 0, MIN(32, 8 * size), sbvalue[k]);
+			for (uint32_t n = batch_start; n < i; n++) {
+				const size_t last_key = (n - batch_start + 1) * size_in_words - 1;
+				for (size_t k = 0; k < size_in_words; ++k) {
+					sbvalue[k] = riscv_batch_get_dmi_read_data(batch, last_key - k);
+					buf_set_u32(buffer + n * size + k * 4, 0, MIN(32, 8 * size), sbvalue[k]);
+				}
+				const target_addr_t read_addr = address + n * increment;
+				log_memory_access(read_addr, sbvalue, size, true);
 			}
 
+			const uint32_t sbcs = riscv_batch_get_dmi_read_data(batch, sbcs_key);
 			riscv_batch_free(batch);
-			const target_addr_t read_addr = address + i * increment;
-			log_memory_access(read_addr, sbvalue, size, true);
+			/* On sbbusyerror the rest of the data can't be trusted. Stop
+			 * here, the code below resumes from the address the bus has
+			 * actually reached. */
+			if (get_field(sbcs, DM_SBCS_SBBUSYERROR) ||
+					get_field(sbcs, DM_SBCS_SBERROR))
+				break;
 		}
 
 		uint32_t sbcs_read = 0;
@@ -3519,8 +3864,7 @@ static int read_memory_bus_v1(struct target *target, const struct riscv_mem_acce
 					return ERROR_FAIL;
 			}
 
-			int res = riscv_scan_increase_delay(&info->learned_delays,
-					RISCV_DELAY_SYSBUS_READ);
+			int res = increase_learned_delay(target, RISCV_DELAY_SYSBUS_READ);
 			if (res != ERROR_OK)
 				return res;
 			continue;
@@ -4716,7 +5060,6 @@ static int write_memory_bus_v1(struct target *target, const struct riscv_mem_acc
 {
 	assert(riscv_mem_access_is_write(args));
 
-	RISCV013_INFO(info);
 	uint32_t sbcs = sb_sbaccess(args.size);
 	sbcs = set_field(sbcs, DM_SBCS_SBAUTOINCREMENT, 1);
 	dm_write(target, DM_SBCS, sbcs);
@@ -4739,7 +5082,8 @@ static int write_memory_bus_v1(struct target *target, const struct riscv_mem_acc
 		for (uint32_t i = (next_address - args.address) / args.size; i < args.count; i++) {
 			const uint8_t *p = args.write_buffer + i * args.size;
 
-			if (riscv_batch_available_scans(batch) < (args.size + 3) / 4)
+			/* Keep one scan for the sbcs read below. */
+			if (riscv_batch_available_scans(batch) < (args.size + 3) / 4 + 1)
 				break;
 
 			uint32_t sbvalue[4] = { 0 };
@@ -4779,6 +5123,11 @@ static int write_memory_bus_v1(struct target *target, const struct riscv_mem_acc
 			next_address += args.size;
 		}
 
+		/* Check the outcome in the same JTAG queue flush. If the bus is
+		 * still busy with the last write, poll sbcs separately below. */
+		const size_t sbcs_key = riscv_batch_add_dm_read(batch, DM_SBCS,
+				RISCV_DELAY_BASE);
+
 		/* Execute the batch of writes */
 		result = batch_run(target, batch);
 		if (result != ERROR_OK) {
@@ -4787,13 +5136,17 @@ static int write_memory_bus_v1(struct target *target, const struct riscv_mem_acc
 		}
 
 		bool dmi_busy_encountered = riscv_batch_was_batch_busy(batch);
+		if (!dmi_busy_encountered)
+			sbcs = riscv_batch_get_dmi_read_data(batch, sbcs_key);
 		riscv_batch_free(batch);
 		if (dmi_busy_encountered)
 			LOG_TARGET_DEBUG(target, "DMI busy encountered during system bus write.");
 
-		result = read_sbcs_nonbusy(target, &sbcs);
-		if (result != ERROR_OK)
-			return result;
+		if (dmi_busy_encountered || get_field(sbcs, DM_SBCS_SBBUSY)) {
+			result = read_sbcs_nonbusy(target, &sbcs);
+			if (result != ERROR_OK)
+				return result;
+		}
 
 		if (get_field(sbcs, DM_SBCS_SBBUSYERROR)) {
 			/* We wrote while the target was busy. */
@@ -4803,8 +5156,7 @@ static int write_memory_bus_v1(struct target *target, const struct riscv_mem_acc
 			/* Slow down before trying again.
 			 * FIXME: Possible overflow is ignored here.
 			 */
-			riscv_scan_increase_delay(&info->learned_delays,
-					RISCV_DELAY_SYSBUS_WRITE);
+			increase_learned_delay(target, RISCV_DELAY_SYSBUS_WRITE);
 		}
 
 		if (get_field(sbcs, DM_SBCS_SBBUSYERROR) || dmi_busy_encountered) {
@@ -5168,6 +5520,20 @@ int riscv013_get_register(struct target *target,
 	return ERROR_OK;
 }
 
+int riscv013_get_gprs(struct target *target, riscv_reg_t *values,
+		const enum gdb_regno *rids, unsigned int count, unsigned int *read)
+{
+	*read = 0;
+	for (unsigned int i = 0; i < count; ++i)
+		assert(rids[i] > GDB_REGNO_ZERO && rids[i] <= GDB_REGNO_XPR31);
+
+	if (dm013_select_target(target) != ERROR_OK)
+		return ERROR_FAIL;
+
+	return register_read_abstract_batch(target, values, rids, count,
+			riscv_xlen(target), read);
+}
+
 int riscv013_set_register(struct target *target, enum gdb_regno rid,
 		riscv_reg_t value)
 {
@@ -5204,6 +5570,38 @@ static int dm013_select_hart(struct target *target, int hart_index)
 	return ERROR_OK;
 }
 
+/* Queue writes of the hart array mask, one word per window of 32 harts. */
+static void batch_fill_hawindow(struct riscv_batch *batch,
+		const uint32_t *hawindow, unsigned int hawindow_count)
+{
+	for (unsigned int i = 0; i < hawindow_count; i++) {
+		riscv_batch_add_dm_write(batch, DM_HAWINDOWSEL, i,
+				/* read_back */ true, RISCV_DELAY_BASE);
+		riscv_batch_add_dm_write(batch, DM_HAWINDOW, hawindow[i],
+				/* read_back */ true, RISCV_DELAY_BASE);
+	}
+}
+
+/* Queue reads of haltsum0 for every window of 32 harts, selecting the first
+ * hart of each window in turn. The read keys are consecutive; the first one
+ * is returned. */
+static size_t batch_fill_haltsum0_reads(struct riscv_batch *batch,
+		unsigned int window_count)
+{
+	size_t first_key = 0;
+	for (unsigned int i = 0; i < window_count; i++) {
+		const uint32_t dmcontrol = set_dmcontrol_hartsel(DM_DMCONTROL_DMACTIVE,
+				i * 32);
+		riscv_batch_add_dm_write(batch, DM_DMCONTROL, dmcontrol,
+				/* read_back */ true, RISCV_DELAY_BASE);
+		const size_t key = riscv_batch_add_dm_read(batch, DM_HALTSUM0,
+				RISCV_DELAY_BASE);
+		if (i == 0)
+			first_key = key;
+	}
+	return first_key;
+}
+
 /* Select all harts that were prepped and that are selectable, clearing the
  * prepped flag on the harts that actually were selected. */
 static int select_prepped_harts(struct target *target)
@@ -5234,7 +5632,7 @@ static int select_prepped_harts(struct target *target)
 		LOG_TARGET_DEBUG(target, "index=%d, prepped=%d", index, info->prepped);
 		if (info->prepped) {
 			info_013->selected = true;
-			hawindow[index / 32] |= 1 << (index % 32);
+			hawindow[index / 32] |= 1U << (index % 32);
 			info->prepped = false;
 			total_selected++;
 			selected_index = index;
@@ -5256,18 +5654,158 @@ static int select_prepped_harts(struct target *target)
 		return ERROR_FAIL;
 	}
 
-	for (unsigned int i = 0; i < hawindow_count; i++) {
-		if (dm_write(target, DM_HAWINDOWSEL, i) != ERROR_OK) {
-			free(hawindow);
-			return ERROR_FAIL;
-		}
-		if (dm_write(target, DM_HAWINDOW, hawindow[i]) != ERROR_OK) {
-			free(hawindow);
-			return ERROR_FAIL;
-		}
+	struct riscv_batch *batch = riscv_batch_alloc(target, 2 * hawindow_count);
+	if (!batch) {
+		free(hawindow);
+		return ERROR_FAIL;
 	}
+	batch_fill_hawindow(batch, hawindow, hawindow_count);
+	int result = batch_run_timeout(target, batch);
+	riscv_batch_free(batch);
+	free(hawindow);
+	return result;
+}
+
+/* Read haltsum0 for every window of 32 harts of the DM with one batch. */
+static int read_haltsum0_windows(struct target *target, uint32_t *haltsum)
+{
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
 
+	/* `hartsel` should not be changed if `abstractcs.busy` is set. */
+	int result = wait_for_idle_if_needed(target);
+	if (result != ERROR_OK)
+		return result;
+
+	const unsigned int window_count = DIV_ROUND_UP(dm->hart_count, 32);
+	struct riscv_batch *batch = riscv_batch_alloc(target, 2 * window_count);
+	if (!batch)
+		return ERROR_FAIL;
+	const size_t first_key = batch_fill_haltsum0_reads(batch, window_count);
+	dm->current_hartid = HART_INDEX_UNKNOWN;
+	result = batch_run_timeout(target, batch);
+	if (result == ERROR_OK) {
+		for (unsigned int i = 0; i < window_count; i++)
+			haltsum[i] = riscv_batch_get_dmi_read_data(batch, first_key + i);
+		dm->current_hartid = (window_count - 1) * 32;
+	}
+	riscv_batch_free(batch);
+	return result;
+}
+
+/* Sample the state of the harts in "targets" that are connected to the DM of
+ * "target": a single batch selects all of them through the hart array mask
+ * to check dmstatus for reset, unavailable or non-existent harts, and reads
+ * haltsum0 for every window of 32 harts. Nothing is sampled if any of those
+ * harts needs the special handling done in riscv013_get_hart_state(). */
+static int sample_dm_hart_states(struct target *target, struct list_head *targets)
+{
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+	if (!dm->hasel_supported || dm->hart_count < 2)
+		return ERROR_OK;
+
+	const unsigned int window_count = DIV_ROUND_UP(dm->hart_count, 32);
+	uint32_t *hawindow = calloc(window_count, sizeof(uint32_t));
+	uint32_t *haltsum = calloc(window_count, sizeof(uint32_t));
+	struct riscv_batch *batch = riscv_batch_alloc(target, 4 * window_count + 2);
+	int result = ERROR_OK;
+	if (!hawindow || !haltsum || !batch) {
+		LOG_ERROR("Out of memory");
+		result = ERROR_FAIL;
+		goto cleanup;
+	}
+
+	unsigned int hart_count = 0;
+	struct target_list *entry;
+	foreach_smp_target(entry, targets) {
+		struct target *t = entry->target;
+		if (!target_was_examined(t) || get_dm(t) != dm)
+			continue;
+		const unsigned int index = get_info(t)->index;
+		hawindow[index / 32] |= 1U << (index % 32);
+		hart_count++;
+	}
+	if (hart_count < 2)
+		goto cleanup;
+
+	/* `hartsel` should not be changed if `abstractcs.busy` is set. */
+	result = wait_for_idle_if_needed(target);
+	if (result != ERROR_OK)
+		goto cleanup;
+
+	riscv_batch_add_dm_write(batch, DM_DMCONTROL,
+			set_dmcontrol_hartsel(DM_DMCONTROL_DMACTIVE, HART_INDEX_MULTIPLE),
+			/* read_back */ true, RISCV_DELAY_BASE);
+	batch_fill_hawindow(batch, hawindow, window_count);
+	const size_t dmstatus_key = riscv_batch_add_dm_read(batch, DM_DMSTATUS,
+			RISCV_DELAY_BASE);
+	const size_t first_haltsum_key = batch_fill_haltsum0_reads(batch, window_count);
+
+	dm->current_hartid = HART_INDEX_UNKNOWN;
+	result = batch_run_timeout(target, batch);
+	if (result != ERROR_OK)
+		goto cleanup;
+	dm->current_hartid = (window_count - 1) * 32;
+
+	const uint32_t dmstatus = riscv_batch_get_dmi_read_data(batch, dmstatus_key);
+	if (!get_field(dmstatus, DM_DMSTATUS_AUTHENTICATED) ||
+			get_field(dmstatus, DM_DMSTATUS_ANYHAVERESET) ||
+			get_field(dmstatus, DM_DMSTATUS_ANYUNAVAIL) ||
+			get_field(dmstatus, DM_DMSTATUS_ANYNONEXISTENT)) {
+		LOG_TARGET_DEBUG(target, "Not sampling hart states, dmstatus=0x%" PRIx32,
+				dmstatus);
+		goto cleanup;
+	}
+	for (unsigned int i = 0; i < window_count; i++)
+		haltsum[i] = riscv_batch_get_dmi_read_data(batch, first_haltsum_key + i);
+
+	foreach_smp_target(entry, targets) {
+		struct target *t = entry->target;
+		if (!target_was_examined(t) || get_dm(t) != dm)
+			continue;
+		const unsigned int index = get_info(t)->index;
+		struct riscv_info *r = riscv_info(t);
+		r->sampled_state = (haltsum[index / 32] & (1U << (index % 32))) ?
+			RISCV_STATE_HALTED : RISCV_STATE_RUNNING;
+		r->has_sampled_state = true;
+	}
+	LOG_TARGET_DEBUG(target, "Sampled the state of %u harts.", hart_count);
+
+cleanup:
+	if (batch)
+		riscv_batch_free(batch);
+	free(haltsum);
 	free(hawindow);
+	return result;
+}
+
+static int riscv013_sample_hart_states(struct target *target, struct list_head *targets)
+{
+	struct target_list *entry;
+	foreach_smp_target(entry, targets) {
+		struct target *t = entry->target;
+		riscv_info(t)->has_sampled_state = false;
+		if (!target_was_examined(t))
+			continue;
+		dm013_info_t *dm = get_dm(t);
+		if (dm)
+			dm->hart_states_sampled = false;
+	}
+
+	foreach_smp_target(entry, targets) {
+		struct target *t = entry->target;
+		if (!target_was_examined(t))
+			continue;
+		dm013_info_t *dm = get_dm(t);
+		if (!dm || dm->hart_states_sampled)
+			continue;
+		dm->hart_states_sampled = true;
+		if (sample_dm_hart_states(t, targets) != ERROR_OK)
+			return ERROR_FAIL;
+	}
 	return ERROR_OK;
 }
 
@@ -5321,6 +5859,22 @@ static int riscv013_halt_go(struct target *target)
 	dm_write(target, DM_DMCONTROL, dmcontrol);
 
 	if (dm->current_hartid == HART_INDEX_MULTIPLE) {
+		/* If no hart is unavailable, the halt summary tells the state of
+		 * all of them at once. */
+		const bool use_haltsum = !get_field(dmstatus, DM_DMSTATUS_ALLHALTED) &&
+			!get_field(dmstatus, DM_DMSTATUS_ANYUNAVAIL);
+		uint32_t *haltsum = NULL;
+		if (use_haltsum) {
+			haltsum = calloc(DIV_ROUND_UP(dm->hart_count, 32), sizeof(uint32_t));
+			if (!haltsum) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+			if (read_haltsum0_windows(target, haltsum) != ERROR_OK) {
+				free(haltsum);
+				return ERROR_FAIL;
+			}
+		}
 		struct target_list *entry;
 		list_for_each_entry(entry, &dm->target_list, lh) {
 			struct target *t = entry->target;
@@ -5330,13 +5884,17 @@ static int riscv013_halt_go(struct target *target)
 				/* All harts are either halted or unavailable. No
 				 * need to read dmstatus for each hart. */
 				t_dmstatus = dmstatus;
+			} else if (use_haltsum) {
+				const unsigned int index = get_info(t)->index;
+				t_dmstatus = (haltsum[index / 32] & (1U << (index % 32))) ?
+					DM_DMSTATUS_ALLHALTED : 0;
 			} else {
 				/* Only some harts were halted/unavailable. Read
 				 * dmstatus for this one to see what its status
 				 * is. */
-				if (dm013_select_target(target) != ERROR_OK)
+				if (dm013_select_target(t) != ERROR_OK)
 					return ERROR_FAIL;
-				if (dm_read(target, &t_dmstatus, DM_DMSTATUS) != ERROR_OK)
+				if (dm_read(t, &t_dmstatus, DM_DMSTATUS) != ERROR_OK)
 					return ERROR_FAIL;
 			}
 			/* Set state for the current target based on its dmstatus. */
@@ -5348,6 +5906,7 @@ static int riscv013_halt_go(struct target *target)
 				t->state = TARGET_UNAVAILABLE;
 			}
 		}
+		free(haltsum);
 
 	} else {
 		/* Set state for the current target based on its dmstatus. */
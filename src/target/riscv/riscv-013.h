@@ -15,6 +15,11 @@ int riscv013_get_register(struct target *target,
 		riscv_reg_t *value, enum gdb_regno rid);
 int riscv013_get_register_buf(struct target *target, uint8_t *value,
 		enum gdb_regno regno);
+/* Read several GPRs with abstract commands queued into one batch. "*read"
+ * is set to the number of leading registers whose values were read; the
+ * rest should be read one at a time. */
+int riscv013_get_gprs(struct target *target, riscv_reg_t *values,
+		const enum gdb_regno *rids, unsigned int count, unsigned int *read);
 int riscv013_set_register(struct target *target, enum gdb_regno rid,
 		riscv_reg_t value);
 int riscv013_set_register_buf(struct target *target, enum gdb_regno regno,
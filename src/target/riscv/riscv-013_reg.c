@@ -13,10 +13,49 @@
 #include "debug_defines.h"
 #include <helper/time_support.h>
 
+/**
+ * GDB asks for all the GPRs one by one as soon as the hart halts. Read the
+ * ones that are not cached yet in a single batch instead of paying a JTAG
+ * round trip (or two) for each of them. Registers that could not be fetched
+ * here are simply left invalid and read the usual way.
+ */
+static void prefetch_gprs(struct target *target)
+{
+	enum gdb_regno rids[GDB_REGNO_XPR31];
+	riscv_reg_t values[GDB_REGNO_XPR31];
+	unsigned int count = 0;
+	const enum gdb_regno last = riscv_supports_extension(target, 'E') ?
+		GDB_REGNO_XPR15 : GDB_REGNO_XPR31;
+	for (enum gdb_regno rid = GDB_REGNO_ZERO + 1; rid <= last; ++rid) {
+		const struct reg *reg = riscv_reg_impl_cache_entry(target, rid);
+		if (reg->exist && !reg->valid)
+			rids[count++] = rid;
+	}
+	if (count < 2)
+		return;
+
+	unsigned int read;
+	if (riscv013_get_gprs(target, values, rids, count, &read) != ERROR_OK)
+		LOG_TARGET_DEBUG(target, "Batched GPR read stopped at %s.",
+				riscv_reg_gdb_regno_name(target, rids[read]));
+
+	for (unsigned int i = 0; i < read; ++i) {
+		struct reg *reg = riscv_reg_impl_cache_entry(target, rids[i]);
+		buf_set_u64(reg->value, 0, reg->size, values[i]);
+		reg->valid = true;
+		reg->dirty = false;
+	}
+	LOG_TARGET_DEBUG(target, "Prefetched %u of %u GPRs.", read, count);
+}
+
 static int riscv013_reg_get(struct reg *reg)
 {
 	struct target *target = riscv_reg_impl_get_target(reg);
 
+	if (reg->number > GDB_REGNO_ZERO && reg->number <= GDB_REGNO_XPR31 &&
+			!reg->valid && target->state == TARGET_HALTED)
+		prefetch_gprs(target);
+
 	/* TODO: Hack to deal with gdb that thinks these registers still exist. */
 	if (reg->number > GDB_REGNO_XPR15 && reg->number <= GDB_REGNO_XPR31 &&
 			riscv_supports_extension(target, 'E')) {
@@ -737,6 +737,7 @@ static void riscv_deinit_target(struct target *target)
 		return;
 
 	free(info->reserved_triggers);
+	free(info->delay_profile);
 
 	range_list_t *entry, *tmp;
 	list_for_each_entry_safe(entry, tmp, &info->hide_csr, list) {
@@ -3873,8 +3874,12 @@ static int riscv_poll_hart(struct target *target, enum riscv_next_action *next_a
 	/* If OpenOCD thinks we're running but this hart is halted then it's time
 	 * to raise an event. */
 	enum riscv_hart_state state;
-	if (riscv_get_hart_state(target, &state) != ERROR_OK)
+	if (r->has_sampled_state) {
+		state = r->sampled_state;
+		r->has_sampled_state = false;
+	} else if (riscv_get_hart_state(target, &state) != ERROR_OK) {
 		return ERROR_FAIL;
+	}
 
 	if (state == RISCV_STATE_NON_EXISTENT) {
 		LOG_TARGET_ERROR(target, "Hart is non-existent!");
@@ -4046,6 +4051,13 @@ int riscv_openocd_poll(struct target *target)
 	unsigned int running = 0;
 	unsigned int cause_groups = 0;
 	struct target_list *entry;
+
+	/* Large SMP groups: get the state of all the harts in one go rather
+	 * than selecting each of them and reading its dmstatus. */
+	if (target->smp && i->sample_hart_states &&
+			i->sample_hart_states(target, targets) != ERROR_OK)
+		return ERROR_FAIL;
+
 	foreach_smp_target(entry, targets) {
 		struct target *t = entry->target;
 		struct riscv_info *info = riscv_info(t);
@@ -4800,6 +4812,54 @@ COMMAND_HANDLER(riscv_reset_delays)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(riscv_delay_profile)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC == 0) {
+		if (r->delay_profile)
+			command_print(CMD, "%s", r->delay_profile);
+		return ERROR_OK;
+	}
+
+	char *filename = strdup(CMD_ARGV[0]);
+	if (!filename) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	free(r->delay_profile);
+	r->delay_profile = filename;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(riscv_delay_stats)
+{
+	bool reset = false;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		reset = true;
+	}
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (!r->print_delay_stats) {
+		command_print(CMD, "Delay statistics are not available for this target.");
+		return ERROR_FAIL;
+	}
+
+	return CALL_COMMAND_HANDLER(r->print_delay_stats, target, reset);
+}
+
 COMMAND_HANDLER(riscv_set_ir)
 {
 	if (CMD_ARGC != 2)
@@ -5746,6 +5806,22 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 			"command resets those learned values after `wait` scans. It's only "
 			"useful for testing OpenOCD itself."
 	},
+	{
+		.name = "delay_profile",
+		.handler = riscv_delay_profile,
+		.mode = COMMAND_ANY,
+		.usage = "[filename]",
+		.help = "Set the file the learned delays are loaded from when the "
+			"target is initialized and saved to on exit."
+	},
+	{
+		.name = "delay_stats",
+		.handler = riscv_delay_stats,
+		.mode = COMMAND_EXEC,
+		.usage = "['reset']",
+		.help = "Display or reset the statistics of the learned delays: busy "
+			"responses and idle cycles spent for each delay class."
+	},
 	{
 		.name = "resume_order",
 		.handler = riscv_resume_order,
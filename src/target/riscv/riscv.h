@@ -230,6 +230,10 @@ struct riscv_info {
 	 * delays, causing them to be relearned. Used for testing. */
 	int reset_delays_wait;
 
+	/* File the learned delays are loaded from when the target is
+	 * initialized and saved to on exit. NULL if not set. */
+	char *delay_profile;
+
 	/* This target has been prepped and is ready to step/resume. */
 	bool prepped;
 	/* This target was selected using hasel. */
@@ -239,6 +243,10 @@ struct riscv_info {
 	bool halted_needs_event_callback;
 	enum target_event halted_callback_event;
 	unsigned int halt_group_repoll_count;
+	/* State of this hart sampled together with the rest of its SMP group by
+	 * sample_hart_states(), used (once) instead of get_hart_state(). */
+	bool has_sampled_state;
+	enum riscv_hart_state sampled_state;
 
 	enum riscv_isrmasking_mode isrmask_mode;
 
@@ -246,6 +254,9 @@ struct riscv_info {
 	 * implementations. */
 	int (*select_target)(struct target *target);
 	int (*get_hart_state)(struct target *target, enum riscv_hart_state *state);
+	/* Optional. Determine the state of all the harts in "targets" at once,
+	 * setting has_sampled_state on the ones it succeeded for. */
+	int (*sample_hart_states)(struct target *target, struct list_head *targets);
 	/* Resume this target, as well as every other prepped target that can be
 	 * resumed near-simultaneously. Clear the prepped flag on any target that
 	 * was resumed. */
@@ -308,6 +319,8 @@ struct riscv_info {
 
 	COMMAND_HELPER((*print_info), struct target *target);
 
+	COMMAND_HELPER((*print_delay_stats), struct target *target, bool reset);
+
 	/* Storage for arch_info of non-custom registers. */
 	riscv_reg_info_t shared_reg_info;
 
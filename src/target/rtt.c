@@ -48,6 +48,38 @@ static const struct rtt_control_params rtt_params_64 = {
 	.flags_offset       = 28
 };
 
+/*
+ * Upper limit for the data read from an up-channel per poll, protects
+ * against huge allocations for corrupted channel descriptions.
+ */
+#define RTT_MAX_READ_SIZE	(1024 * 1024)
+
+/*
+ * Up-channel data is read into this buffer and handed to the sinks from
+ * there. It grows to the size of the largest channel, so that a channel is
+ * drained completely on each poll.
+ */
+static uint8_t *read_buffer;
+static size_t read_buffer_size;
+
+static int resize_read_buffer(size_t size)
+{
+	uint8_t *tmp;
+
+	if (size <= read_buffer_size)
+		return ERROR_OK;
+
+	tmp = realloc(read_buffer, size);
+
+	if (!tmp)
+		return ERROR_FAIL;
+
+	read_buffer = tmp;
+	read_buffer_size = size;
+
+	return ERROR_OK;
+}
+
 static const struct rtt_control_params *get_rtt_params(struct target *target)
 {
 	if (target_address_bits(target) == 64)
@@ -55,24 +87,25 @@ static const struct rtt_control_params *get_rtt_params(struct target *target)
 	return &rtt_params_32;
 }
 
-static int read_rtt_channel(struct target *target,
+static target_addr_t rtt_channel_address(struct target *target,
 		const struct rtt_control *ctrl, unsigned int channel_index,
-		enum rtt_channel_type type, struct rtt_channel *channel)
+		enum rtt_channel_type type)
 {
-	int ret;
-	uint8_t buf[RTT_CHANNEL_SIZE_64];
-	target_addr_t address;
 	const struct rtt_control_params *params = get_rtt_params(target);
+	target_addr_t address;
 
 	address = ctrl->address + RTT_CB_SIZE + (channel_index * params->channel_size);
 
 	if (type == RTT_CHANNEL_TYPE_DOWN)
 		address += ctrl->num_up_channels * params->channel_size;
 
-	ret = target_read_buffer(target, address, params->channel_size, buf);
+	return address;
+}
 
-	if (ret != ERROR_OK)
-		return ret;
+static void parse_rtt_channel(struct target *target, const uint8_t *buf,
+		target_addr_t address, struct rtt_channel *channel)
+{
+	const struct rtt_control_params *params = get_rtt_params(target);
 
 	channel->address = address;
 	if (target_address_bits(target) == 64) {
@@ -86,6 +119,26 @@ static int read_rtt_channel(struct target *target,
 	channel->write_pos = target_buffer_get_u32(target, buf + params->write_pos_offset);
 	channel->read_pos = target_buffer_get_u32(target, buf + params->read_pos_offset);
 	channel->flags = target_buffer_get_u32(target, buf + params->flags_offset);
+}
+
+static int read_rtt_channel(struct target *target,
+		const struct rtt_control *ctrl, unsigned int channel_index,
+		enum rtt_channel_type type, struct rtt_channel *channel)
+{
+	int ret;
+	uint8_t buf[RTT_CHANNEL_SIZE_64];
+	target_addr_t address;
+	const struct rtt_control_params *params = get_rtt_params(target);
+
+	address = rtt_channel_address(target, ctrl, channel_index, type);
+
+	ret = target_read_buffer(target, address, params->channel_size, buf);
+
+	if (ret != ERROR_OK)
+		return ret;
+
+	parse_rtt_channel(target, buf, address, channel);
+
 	return ERROR_OK;
 }
 
@@ -97,6 +150,10 @@ int target_rtt_start(struct target *target, const struct rtt_control *ctrl,
 
 int target_rtt_stop(struct target *target, void *user_data)
 {
+	free(read_buffer);
+	read_buffer = NULL;
+	read_buffer_size = 0;
+
 	return ERROR_OK;
 }
 
@@ -410,27 +467,53 @@ static int read_from_channel(struct target *target,
 
 int target_rtt_read_callback(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data)
+		struct rtt_channel_stats *stats, size_t num_channels, void *user_data)
 {
+	int ret;
+	uint8_t *channels_buf;
+	const struct rtt_control_params *params = get_rtt_params(target);
+
 	num_channels = MIN(num_channels, ctrl->num_up_channels);
 
+	/* Only the channels up to the last one with a sink are of interest */
+	while (num_channels > 0 && !sinks[num_channels - 1])
+		num_channels--;
+
+	if (!num_channels)
+		return ERROR_OK;
+
+	/*
+	 * The up-channel descriptions are stored one after the other, read
+	 * them all at once instead of one target access per channel.
+	 */
+	channels_buf = malloc(num_channels * params->channel_size);
+
+	if (!channels_buf) {
+		LOG_ERROR("rtt: Failed to allocate channel buffer");
+		return ERROR_FAIL;
+	}
+
+	ret = target_read_buffer(target,
+		rtt_channel_address(target, ctrl, 0, RTT_CHANNEL_TYPE_UP),
+		num_channels * params->channel_size, channels_buf);
+
+	if (ret != ERROR_OK) {
+		LOG_ERROR("rtt: Failed to read up-channel descriptions");
+		free(channels_buf);
+		return ret;
+	}
+
 	for (size_t i = 0; i < num_channels; i++) {
-		int ret;
 		struct rtt_channel channel;
-		uint8_t buffer[1024];
 		size_t length;
 
 		if (!sinks[i])
 			continue;
 
-		ret = read_rtt_channel(target, ctrl, i, RTT_CHANNEL_TYPE_UP,
+		parse_rtt_channel(target, channels_buf + i * params->channel_size,
+			rtt_channel_address(target, ctrl, i, RTT_CHANNEL_TYPE_UP),
 			&channel);
 
-		if (ret != ERROR_OK) {
-			LOG_ERROR("rtt: Failed to read up-channel %zu description", i);
-			return ret;
-		}
-
 		if (!channel_is_active(&channel)) {
 			LOG_WARNING("rtt: Up-channel %zu is not active", i);
 			continue;
@@ -441,17 +524,49 @@ int target_rtt_read_callback(struct target *target,
 			continue;
 		}
 
-		length = sizeof(buffer);
-		ret = read_from_channel(target, &channel, buffer, &length);
+		/* Nothing to read, save the target accesses */
+		if (channel.read_pos == channel.write_pos)
+			continue;
+
+		/* Read everything the channel holds, at most size - 1 bytes */
+		length = MIN(channel.size, RTT_MAX_READ_SIZE);
+
+		if (resize_read_buffer(length) != ERROR_OK) {
+			LOG_ERROR("rtt: Failed to allocate read buffer");
+			free(channels_buf);
+			return ERROR_FAIL;
+		}
+
+		ret = read_from_channel(target, &channel, read_buffer, &length);
 
 		if (ret != ERROR_OK) {
 			LOG_ERROR("rtt: Failed to read from up-channel %zu", i);
+			free(channels_buf);
 			return ret;
 		}
 
-		for (struct rtt_sink_list *sink = sinks[i]; sink; sink = sink->next)
-			sink->read(i, buffer, length, sink->user_data);
+		if (length) {
+			stats[i].bytes += length;
+			stats[i].active_polls++;
+		}
+
+		/*
+		 * A full buffer means the target could not write more, so it
+		 * either dropped data or blocked, depending on the channel mode.
+		 */
+		if (length == channel.size - 1)
+			stats[i].overflows++;
+
+		for (struct rtt_sink_list *sink = sinks[i]; sink; sink = sink->next) {
+			size_t written = 0;
+
+			/* only the part the sink did not take is lost */
+			if (sink->read(i, read_buffer, length, &written, sink->user_data) != ERROR_OK)
+				stats[i].dropped += length - MIN(written, length);
+		}
 	}
 
+	free(channels_buf);
+
 	return ERROR_OK;
 }
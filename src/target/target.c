@@ -71,6 +71,7 @@ static int target_get_gdb_fileio_info_default(struct target *target,
 		struct gdb_fileio_info *fileio_info);
 static int target_gdb_fileio_end_default(struct target *target, int retcode,
 		int fileio_errno, bool ctrl_c);
+static void target_mem_cache_invalidate_all(void);
 
 static struct target_type *target_types[] = {
 	// Keep in alphabetic order this list of targets
@@ -574,6 +575,8 @@ int target_resume(struct target *target, bool current, target_addr_t address,
 		return ERROR_TARGET_NOT_EXAMINED;
 	}
 
+	target_mem_cache_invalidate_all();
+
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_START);
 
 	/* note that resume *must* be asynchronous. The CPU can halt before
@@ -1250,6 +1253,194 @@ int target_run_read_async_algorithm(struct target *target,
 	return retval;
 }
 
+#define TARGET_MEM_CACHE_PAGE_SIZE	256
+#define TARGET_MEM_CACHE_NUM_PAGES	256
+
+/* Address range where reads are allowed to go through the cache */
+struct target_mem_cache_range {
+	target_addr_t address;
+	target_addr_t size;
+};
+
+struct target_mem_cache_page {
+	bool valid;
+	target_addr_t address;
+	uint8_t data[TARGET_MEM_CACHE_PAGE_SIZE];
+};
+
+/*
+ * Host side, direct mapped cache of the memory of a halted target.
+ * Only reads in the configured ranges are cached, the content is dropped
+ * on resume, step, any memory write, reset and any target event.
+ */
+struct target_mem_cache {
+	struct target_mem_cache_range *ranges;
+	unsigned int num_ranges;
+	unsigned int valid_pages;
+	/* set while a page is read from the target */
+	bool filling;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t invalidations;
+	struct target_mem_cache_page pages[TARGET_MEM_CACHE_NUM_PAGES];
+};
+
+static void target_mem_cache_invalidate(struct target *target)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+
+	if (!cache || !cache->valid_pages)
+		return;
+
+	for (unsigned int i = 0; i < TARGET_MEM_CACHE_NUM_PAGES; i++)
+		cache->pages[i].valid = false;
+	cache->valid_pages = 0;
+	cache->invalidations++;
+}
+
+/* memory can be shared between targets, drop the content of every cache */
+static void target_mem_cache_invalidate_all(void)
+{
+	for (struct target *target = all_targets; target; target = target->next)
+		target_mem_cache_invalidate(target);
+}
+
+static void target_mem_cache_free(struct target *target)
+{
+	if (!target->mem_cache)
+		return;
+
+	free(target->mem_cache->ranges);
+	free(target->mem_cache);
+	target->mem_cache = NULL;
+}
+
+static bool target_mem_cache_covers(struct target *target,
+		target_addr_t address, uint32_t size)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+
+	if (!cache || cache->filling || size == 0)
+		return false;
+
+	if (target->state != TARGET_HALTED) {
+		target_mem_cache_invalidate(target);
+		return false;
+	}
+
+	target_addr_t last = address + size - 1;
+	if (last < address)
+		return false;
+
+	for (unsigned int i = 0; i < cache->num_ranges; i++) {
+		struct target_mem_cache_range *range = &cache->ranges[i];
+		if (address >= range->address && last <= range->address + (range->size - 1))
+			return true;
+	}
+
+	return false;
+}
+
+static struct target_mem_cache_page *target_mem_cache_slot(struct target_mem_cache *cache,
+		target_addr_t page_address)
+{
+	return &cache->pages[(page_address / TARGET_MEM_CACHE_PAGE_SIZE) % TARGET_MEM_CACHE_NUM_PAGES];
+}
+
+static bool target_mem_cache_hit(struct target_mem_cache *cache, target_addr_t page_address)
+{
+	struct target_mem_cache_page *page = target_mem_cache_slot(cache, page_address);
+
+	return page->valid && page->address == page_address;
+}
+
+/* read num_pages consecutive pages with a single access to the target */
+static int target_mem_cache_fill(struct target *target,
+		target_addr_t page_address, unsigned int num_pages)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+	uint32_t size = num_pages * TARGET_MEM_CACHE_PAGE_SIZE;
+
+	for (unsigned int i = 0; i < num_pages; i++) {
+		struct target_mem_cache_page *page =
+			target_mem_cache_slot(cache, page_address + i * TARGET_MEM_CACHE_PAGE_SIZE);
+		if (page->valid) {
+			page->valid = false;
+			cache->valid_pages--;
+		}
+	}
+	cache->misses += num_pages;
+
+	uint8_t *data = malloc(size);
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	/* ranges are page aligned, whole pages can be read */
+	cache->filling = true;
+	int retval = target->type->read_buffer(target, page_address, size, data);
+	cache->filling = false;
+
+	if (retval == ERROR_OK) {
+		for (unsigned int i = 0; i < num_pages; i++) {
+			struct target_mem_cache_page *page = target_mem_cache_slot(cache, page_address);
+			memcpy(page->data, data + i * TARGET_MEM_CACHE_PAGE_SIZE, TARGET_MEM_CACHE_PAGE_SIZE);
+			page->address = page_address;
+			page->valid = true;
+			cache->valid_pages++;
+			page_address += TARGET_MEM_CACHE_PAGE_SIZE;
+		}
+	}
+
+	free(data);
+	return retval;
+}
+
+static int target_mem_cache_read(struct target *target,
+		target_addr_t address, uint32_t size, uint8_t *buffer)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+	const target_addr_t page_mask = ~(target_addr_t)(TARGET_MEM_CACHE_PAGE_SIZE - 1);
+	target_addr_t last_page = (address + size - 1) & page_mask;
+	/* pages of the current run that were just read from the target */
+	unsigned int filled = 0;
+
+	while (size > 0) {
+		target_addr_t page_address = address & page_mask;
+		uint32_t offset = address - page_address;
+		uint32_t count = MIN(size, TARGET_MEM_CACHE_PAGE_SIZE - offset);
+
+		if (filled > 0) {
+			filled--;
+		} else if (target_mem_cache_hit(cache, page_address)) {
+			cache->hits++;
+		} else {
+			/* extend the miss over the following missed pages of the request,
+			 * at most one lap of the cache so that the run's slots are distinct */
+			target_addr_t remaining = (last_page - page_address) / TARGET_MEM_CACHE_PAGE_SIZE;
+			unsigned int num_pages = 1;
+			while (num_pages < TARGET_MEM_CACHE_NUM_PAGES && num_pages <= remaining
+					&& !target_mem_cache_hit(cache,
+						page_address + num_pages * TARGET_MEM_CACHE_PAGE_SIZE))
+				num_pages++;
+
+			int retval = target_mem_cache_fill(target, page_address, num_pages);
+			if (retval != ERROR_OK)
+				return retval;
+			filled = num_pages - 1;
+		}
+
+		struct target_mem_cache_page *page = target_mem_cache_slot(cache, page_address);
+		memcpy(buffer, page->data + offset, count);
+		address += count;
+		buffer += count;
+		size -= count;
+	}
+
+	return ERROR_OK;
+}
+
 bool target_memory_ready(struct target *target)
 {
 	if (target->type->memory_ready)
@@ -1269,6 +1460,8 @@ int target_read_memory(struct target *target,
 		LOG_TARGET_ERROR(target, "doesn't support read_memory");
 		return ERROR_FAIL;
 	}
+	if (target_mem_cache_covers(target, address, size * count))
+		return target_mem_cache_read(target, address, size * count, buffer);
 	return target->type->read_memory(target, address, size, count, buffer);
 }
 
@@ -1297,6 +1490,8 @@ int target_write_memory(struct target *target,
 		LOG_TARGET_ERROR(target, "doesn't support write_memory");
 		return ERROR_FAIL;
 	}
+	target_mem_cache_invalidate_all();
+	rtos_invalidate_reg_caches();
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1311,6 +1506,8 @@ int target_write_phys_memory(struct target *target,
 		LOG_TARGET_ERROR(target, "doesn't support write_phys_memory");
 		return ERROR_FAIL;
 	}
+	target_mem_cache_invalidate_all();
+	rtos_invalidate_reg_caches();
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1442,6 +1639,8 @@ int target_step(struct target *target,
 		return ERROR_TARGET_NOT_EXAMINED;
 	}
 
+	target_mem_cache_invalidate_all();
+
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
 
 	retval = target->type->step(target, current, address, handle_breakpoints);
@@ -1827,6 +2026,9 @@ int target_call_event_callbacks(struct target *target, enum target_event event)
 			target_event_name(event),
 			target_name(target));
 
+	/* halt, reset, flash programming... can come with new memory content */
+	target_mem_cache_invalidate_all();
+
 	target_handle_event(target, event);
 
 	while (callback) {
@@ -1845,6 +2047,8 @@ int target_call_reset_callbacks(struct target *target, enum target_reset_mode re
 	LOG_DEBUG("target reset %i (%s)", reset_mode,
 			nvp_value2name(nvp_reset_modes, reset_mode)->name);
 
+	target_mem_cache_invalidate_all();
+
 	list_for_each_entry(callback, &target_reset_callback_list, list)
 		callback->callback(target, reset_mode, callback->priv);
 
@@ -2274,6 +2478,8 @@ static void target_destroy(struct target *target)
 
 	rtos_destroy(target);
 
+	target_mem_cache_free(target);
+
 	free(target->gdb_port_override);
 	free(target->type);
 	free(target->trace_info);
@@ -2423,6 +2629,9 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	target_mem_cache_invalidate_all();
+	rtos_invalidate_reg_caches();
+
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -2488,6 +2697,9 @@ int target_read_buffer(struct target *target, target_addr_t address, uint32_t si
 		return ERROR_FAIL;
 	}
 
+	if (target_mem_cache_covers(target, address, size))
+		return target_mem_cache_read(target, address, size, buffer);
+
 	return target->type->read_buffer(target, address, size, buffer);
 }
 
@@ -3130,6 +3342,7 @@ COMMAND_HANDLER(handle_reg_command)
 			return retval;
 		}
 
+		rtos_invalidate_reg_caches();
 		retval = reg->type->set(reg, buf);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Could not write to register '%s'", reg->name);
@@ -3627,6 +3840,7 @@ static COMMAND_HELPER(parse_load_image_command, struct image *image,
 
 COMMAND_HANDLER(handle_load_image_command)
 {
+	const uint8_t *data;
 	uint8_t *buffer;
 	size_t buf_cnt;
 	uint32_t image_size;
@@ -3650,20 +3864,10 @@ COMMAND_HANDLER(handle_load_image_command)
 	image_size = 0x0;
 	retval = ERROR_OK;
 	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD,
-						  "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		retval = image_section_data(&image, i, 0x0, image.sections[i].size,
+				&data, &buffer, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
 
 		uint32_t offset = 0;
 		uint32_t length = buf_cnt;
@@ -3683,7 +3887,7 @@ COMMAND_HANDLER(handle_load_image_command)
 				length -= (image.sections[i].base_address + buf_cnt)-max_address;
 
 			retval = target_write_buffer(target,
-					image.sections[i].base_address + offset, length, buffer + offset);
+					image.sections[i].base_address + offset, length, data + offset);
 			if (retval != ERROR_OK) {
 				free(buffer);
 				break;
@@ -3779,6 +3983,7 @@ enum verify_mode {
 
 static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode verify)
 {
+	const uint8_t *data;
 	uint8_t *buffer;
 	size_t buf_cnt;
 	uint32_t image_size;
@@ -3821,22 +4026,14 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 	int diffs = 0;
 	retval = ERROR_OK;
 	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD,
-					"error allocating buffer for section (%" PRIu32 " bytes)",
-					image.sections[i].size);
-			break;
-		}
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		retval = image_section_data(&image, i, 0x0, image.sections[i].size,
+				&data, &buffer, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
 
 		if (verify >= IMAGE_VERIFY) {
 			/* calculate checksum of image */
-			retval = image_calculate_checksum(buffer, buf_cnt, &checksum);
+			retval = image_calculate_checksum(data, buf_cnt, &checksum);
 			if (retval != ERROR_OK) {
 				free(buffer);
 				break;
@@ -3855,27 +4052,27 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 			}
 			if (checksum != mem_checksum) {
 				/* failed crc checksum, fall back to a binary compare */
-				uint8_t *data;
+				uint8_t *target_data;
 
 				if (diffs == 0)
 					LOG_ERROR("checksum mismatch - attempting binary compare");
 
-				data = malloc(buf_cnt);
+				target_data = malloc(buf_cnt);
 
-				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, data);
+				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, target_data);
 				if (retval == ERROR_OK) {
 					uint32_t t;
 					for (t = 0; t < buf_cnt; t++) {
-						if (data[t] != buffer[t]) {
+						if (target_data[t] != data[t]) {
 							command_print(CMD,
 								"diff %d address " TARGET_ADDR_FMT ". Was 0x%02" PRIx8 " instead of 0x%02" PRIx8,
 								diffs,
 								t + image.sections[i].base_address,
-								data[t],
-								buffer[t]);
+								target_data[t],
+								data[t]);
 							if (diffs++ >= 127) {
 								command_print(CMD, "More than 128 errors, the rest are not printed.");
-								free(data);
+								free(target_data);
 								free(buffer);
 								goto done;
 							}
@@ -3883,13 +4080,13 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 						keep_alive();
 						if (openocd_is_shutdown_pending()) {
 							retval = ERROR_SERVER_INTERRUPTED;
-							free(data);
+							free(target_data);
 							free(buffer);
 							goto done;
 						}
 					}
 				}
-				free(data);
+				free(target_data);
 			}
 		} else {
 			command_print(CMD, "address " TARGET_ADDR_FMT " length 0x%08zx",
@@ -4858,6 +5055,7 @@ COMMAND_HANDLER(handle_set_reg_command)
 			return retval;
 		}
 
+		rtos_invalidate_reg_caches();
 		retval = reg->type->set(reg, buf);
 		free(buf);
 
@@ -5527,6 +5725,120 @@ COMMAND_HANDLER(handle_target_current_state)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_target_mem_cache_add)
+{
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	target_addr_t address, size;
+
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[1], size);
+
+	if (size == 0 || address % TARGET_MEM_CACHE_PAGE_SIZE
+			|| size % TARGET_MEM_CACHE_PAGE_SIZE) {
+		command_print(CMD, "address and size must be non zero multiples of %u",
+				TARGET_MEM_CACHE_PAGE_SIZE);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (address + (size - 1) < address) {
+		command_print(CMD, "range wraps around the address space");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (!target->mem_cache) {
+		target->mem_cache = calloc(1, sizeof(*target->mem_cache));
+		if (!target->mem_cache) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	struct target_mem_cache *cache = target->mem_cache;
+	struct target_mem_cache_range *ranges = realloc(cache->ranges,
+			(cache->num_ranges + 1) * sizeof(*ranges));
+	if (!ranges) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	ranges[cache->num_ranges].address = address;
+	ranges[cache->num_ranges].size = size;
+	cache->ranges = ranges;
+	cache->num_ranges++;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_target_mem_cache_clear)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_mem_cache_free(get_current_target(CMD_CTX));
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_target_mem_cache_flush)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_mem_cache_invalidate(get_current_target(CMD_CTX));
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_target_mem_cache_list)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target_mem_cache *cache = get_current_target(CMD_CTX)->mem_cache;
+	if (!cache)
+		return ERROR_OK;
+
+	for (unsigned int i = 0; i < cache->num_ranges; i++)
+		command_print(CMD, TARGET_ADDR_FMT " " TARGET_ADDR_FMT,
+				cache->ranges[i].address, cache->ranges[i].size);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_target_mem_cache_stats)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target_mem_cache *cache = get_current_target(CMD_CTX)->mem_cache;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		if (cache) {
+			cache->hits = 0;
+			cache->misses = 0;
+			cache->invalidations = 0;
+		}
+		return ERROR_OK;
+	}
+
+	if (!cache) {
+		command_print(CMD, "memory cache not configured");
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "hits:          %" PRIu64, cache->hits);
+	command_print(CMD, "misses:        %" PRIu64, cache->misses);
+	command_print(CMD, "invalidations: %" PRIu64, cache->invalidations);
+	command_print(CMD, "valid pages:   %u", cache->valid_pages);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_target_debug_reason)
 {
 	if (CMD_ARGC != 0)
@@ -5595,6 +5907,45 @@ COMMAND_HANDLER(handle_target_disassemble)
 	return oocd_cs_disassemble(CMD, target, address, count, insn_set);
 }
 
+static const struct command_registration target_mem_cache_command_handlers[] = {
+	{
+		.name = "add",
+		.mode = COMMAND_ANY,
+		.handler = handle_target_mem_cache_add,
+		.help = "allow caching the reads in a memory range",
+		.usage = "address size",
+	},
+	{
+		.name = "clear",
+		.mode = COMMAND_ANY,
+		.handler = handle_target_mem_cache_clear,
+		.help = "remove all the ranges and disable the cache",
+		.usage = "",
+	},
+	{
+		.name = "flush",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_mem_cache_flush,
+		.help = "drop the cached memory content",
+		.usage = "",
+	},
+	{
+		.name = "list",
+		.mode = COMMAND_ANY,
+		.handler = handle_target_mem_cache_list,
+		.help = "list the cached memory ranges",
+		.usage = "",
+	},
+	{
+		.name = "stats",
+		.mode = COMMAND_EXEC,
+		.handler = handle_target_mem_cache_stats,
+		.help = "display or reset the cache statistics",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration target_instance_command_handlers[] = {
 	{
 		.name = "configure",
@@ -5785,6 +6136,13 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help = "disassemble instructions",
 		.usage = "list | address [count [instruction_set]]",
 	},
+	{
+		.name = "mem_cache",
+		.mode = COMMAND_ANY,
+		.help = "host side cache of memory reads while halted",
+		.usage = "",
+		.chain = target_mem_cache_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
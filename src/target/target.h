@@ -36,6 +36,7 @@ struct mem_param;
 struct reg_param;
 struct target_list;
 struct gdb_fileio_info;
+struct target_mem_cache;
 
 /*
  * TARGET_UNKNOWN = 0: we don't know anything about the target yet
@@ -220,6 +221,9 @@ struct target {
 
 	/* The semihosting information, extracted from the target. */
 	struct semihosting *semihosting;
+
+	/* host side cache of memory reads, NULL unless configured */
+	struct target_mem_cache *mem_cache;
 };
 
 struct target_list {
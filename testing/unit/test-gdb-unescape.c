@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Check the fast path used to unescape gdb packets against the byte at a
+ * time loop it replaced, on random data mixing plain characters, '}'
+ * escapes and '#'.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <server/gdb_server.h>
+
+#define MAX_RUN 256
+
+static int ref_unescape_run(const char *in, int size, char *out, int *out_count,
+		unsigned char *checksum, bool *done)
+{
+	const char *buf = in;
+	int count = 0;
+	int i = 0;
+
+	*done = false;
+	while (i < size) {
+		int character = *buf++;
+		i++;
+		if (character == '#') {
+			*done = true;
+			break;
+		}
+
+		if (character == '}') {
+			*checksum += character & 0xff;
+			character = *buf++;
+			i++;
+			*checksum += character & 0xff;
+			out[count++] = (character ^ 0x20) & 0xff;
+		} else {
+			*checksum += character & 0xff;
+			out[count++] = character & 0xff;
+		}
+	}
+
+	*out_count = count;
+	return i;
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t next_rand(void)
+{
+	/* xorshift32, the sequence must not depend on the C library */
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return rand_state;
+}
+
+int main(void)
+{
+	char in[MAX_RUN + 2];
+	char out[MAX_RUN], ref_out[MAX_RUN];
+	int failures = 0;
+
+	for (int iter = 0; iter < 200000; iter++) {
+		int size = next_rand() % MAX_RUN;
+		/* escapes and end of packet, more or less frequent */
+		uint32_t density = 1 + next_rand() % 64;
+
+		for (int i = 0; i < size + 2; i++) {
+			uint32_t r = next_rand();
+			if (r % density == 0)
+				in[i] = (r & 0x100) ? '#' : '}';
+			else
+				in[i] = r >> 24;
+		}
+
+		unsigned char checksum = iter, ref_checksum = iter;
+		int count, ref_count;
+		bool done, ref_done;
+
+		memset(out, 0, sizeof(out));
+		memset(ref_out, 0, sizeof(ref_out));
+		int n = gdb_unescape_run(in, size, out, &count, &checksum, &done);
+		int ref_n = ref_unescape_run(in, size, ref_out, &ref_count,
+				&ref_checksum, &ref_done);
+
+		if (n != ref_n || count != ref_count || checksum != ref_checksum ||
+				done != ref_done || memcmp(out, ref_out, sizeof(out))) {
+			printf("iteration %d, size %d: consumed %d/%d, stored %d/%d, "
+					"checksum 0x%02x/0x%02x, done %d/%d\n",
+					iter, size, n, ref_n, count, ref_count,
+					checksum, ref_checksum, done, ref_done);
+			failures++;
+		}
+	}
+
+	if (failures) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
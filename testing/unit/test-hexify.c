@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Check hexify() and unhexify() against the straightforward nibble at a
+ * time implementations they replaced, on edge cases and random inputs.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <helper/binarybuffer.h>
+
+#define MAX_BYTES 64
+
+static const char ref_digits[] = "0123456789abcdef";
+
+static size_t ref_unhexify(uint8_t *bin, const char *hex, size_t count)
+{
+	size_t i;
+	char tmp;
+
+	memset(bin, 0, count);
+
+	for (i = 0; i < 2 * count; i++) {
+		if (hex[i] >= 'a' && hex[i] <= 'f')
+			tmp = hex[i] - 'a' + 10;
+		else if (hex[i] >= 'A' && hex[i] <= 'F')
+			tmp = hex[i] - 'A' + 10;
+		else if (hex[i] >= '0' && hex[i] <= '9')
+			tmp = hex[i] - '0';
+		else
+			return i / 2;
+
+		bin[i / 2] |= tmp << (4 * ((i + 1) % 2));
+	}
+
+	return i / 2;
+}
+
+static size_t ref_hexify(char *hex, const uint8_t *bin, size_t count, size_t length)
+{
+	size_t i;
+
+	if (!length)
+		return 0;
+
+	for (i = 0; i < length - 1 && i < 2 * count; i++)
+		hex[i] = ref_digits[(bin[i / 2] >> (4 * ((i + 1) % 2))) & 0x0f];
+
+	hex[i] = 0;
+
+	return i;
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t next_rand(void)
+{
+	/* xorshift32, the sequence must not depend on the C library */
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return rand_state;
+}
+
+static int failures;
+
+static void check_unhexify(const char *hex, size_t count)
+{
+	uint8_t bin[MAX_BYTES], ref_bin[MAX_BYTES];
+
+	memset(bin, 0x55, sizeof(bin));
+	memset(ref_bin, 0x55, sizeof(ref_bin));
+	size_t n = unhexify(bin, hex, count);
+	size_t ref_n = ref_unhexify(ref_bin, hex, count);
+
+	if (n != ref_n || memcmp(bin, ref_bin, sizeof(bin))) {
+		printf("unhexify(\"%.*s\", %zu) returned %zu, expected %zu\n",
+				(int)(2 * count), hex, count, n, ref_n);
+		failures++;
+	}
+}
+
+static void check_hexify(const uint8_t *bin, size_t count, size_t length)
+{
+	char hex[2 * MAX_BYTES + 2], ref_hex[2 * MAX_BYTES + 2];
+
+	memset(hex, 'x', sizeof(hex));
+	memset(ref_hex, 'x', sizeof(ref_hex));
+	size_t n = hexify(hex, bin, count, length);
+	size_t ref_n = ref_hexify(ref_hex, bin, count, length);
+
+	if (n != ref_n || memcmp(hex, ref_hex, sizeof(hex))) {
+		printf("hexify(%zu bytes, length %zu) returned %zu, expected %zu\n",
+				count, length, n, ref_n);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	static const char charset[] = "0123456789abcdefABCDEF gG:#}\xff";
+	char hex[2 * MAX_BYTES + 1];
+	uint8_t bin[MAX_BYTES];
+
+	/* all the characters in both positions of a pair */
+	for (int c = 1; c < 256; c++) {
+		hex[0] = c;
+		hex[1] = '7';
+		hex[2] = 0;
+		check_unhexify(hex, 1);
+		hex[0] = 'a';
+		hex[1] = c;
+		check_unhexify(hex, 1);
+	}
+	check_unhexify("", 0);
+	check_unhexify("", 4);
+	check_unhexify("0123456789abcdefABCDEF", 11);
+	check_unhexify("012", 2);
+
+	for (size_t length = 0; length < 8; length++)
+		check_hexify((const uint8_t *)"\x01\xab\xff", 3, length);
+
+	for (int iter = 0; iter < 100000; iter++) {
+		size_t count = next_rand() % MAX_BYTES;
+
+		/* mostly valid digits, with an invalid one from time to time */
+		for (size_t i = 0; i < 2 * count; i++) {
+			uint32_t r = next_rand();
+			hex[i] = (r & 0xff00) ? charset[r % 22] : charset[r % (sizeof(charset) - 1)];
+		}
+		hex[2 * count] = 0;
+		check_unhexify(hex, count);
+
+		for (size_t i = 0; i < count; i++)
+			bin[i] = next_rand();
+		check_hexify(bin, count, next_rand() % (2 * MAX_BYTES + 2));
+	}
+
+	if (failures) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+
+	return 0;
+}